@@ -0,0 +1,15 @@
+# Build Python bindings of LDA/LDADF:
+# $ python setup.py build_ext --inplace
+from setuptools import setup, Extension
+
+import numpy
+
+srcs = ['pyldadf.cc', 'utils.cc', 'counts.cc', 'scheduler.cc', 'lda.cc', 'dtree.cc', 'ldadf.cc', 'ldak.cc']
+pyldadf = Extension('pyldadf',
+                    sources=['src/' + src for src in srcs],
+                    include_dirs=[numpy.get_include()],
+                    extra_compile_args=['-O2'])
+
+setup(name='pyldadf',
+      description='LDA with logical constraints on words',
+      ext_modules=[pyldadf])
@@ -0,0 +1,213 @@
+#include "ldak.h"
+
+#include <cstdlib>
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+using namespace std;
+
+#include <getopt.h>
+
+#include "utils.h"
+using namespace ldautils;
+
+// harness to time each phase of training separately
+class LDABench {
+ public:
+  LDABench(LDA *lda, int num_steps) : lda(lda), num_steps(num_steps) {};
+
+  void run();
+  void save_results(const string &filename);
+
+ private:
+  LDA *lda;
+  int num_steps;
+  double pp;
+};
+
+void
+LDABench::run() {
+  lda->initialize(); // load_data, load_dnf
+
+  double start = get_time();
+  lda->preprocess();
+  lda->timings["preprocess"] += get_time() - start;
+
+  for(int i = 0; i < num_steps; ++i) {
+    lda->resample(); // sample_dtrees, sample_topics
+  }
+
+  start = get_time();
+  pp = lda->calc_perplexity();
+  lda->timings["perplexity"] += get_time() - start;
+
+  start = get_time();
+  lda->save_params(lda->out_base + ".bench");
+  lda->timings["save_params"] += get_time() - start;
+}
+
+void
+LDABench::save_results(const string &filename) {
+  ofstream file(filename.c_str());
+  if(!file.is_open()) {
+    throw runtime_error(string("LDABench::save_results(): cannot open ") + filename);
+  }
+
+  double num_tokens = static_cast<double>(lda->num_terms) * num_steps;
+  double sample_time = 0.0;
+  if(lda->timings.count("sample_dtrees") > 0) {
+    sample_time += lda->timings["sample_dtrees"];
+  }
+  sample_time += lda->timings["sample_topics"];
+
+  file << "num_docs\t" << lda->num_docs << endl;
+  file << "num_words\t" << lda->num_words << endl;
+  file << "num_terms\t" << lda->num_terms << endl;
+  file << "num_topics\t" << lda->num_topics << endl;
+  file << "num_steps\t" << num_steps << endl;
+  file << "word_major\t" << lda->word_major << endl;
+  file << "compact_counts\t" << lda->compact_counts << endl;
+  file << "count_bytes\t" << lda->cdz.bytes() + lda->cwz.bytes() << endl;
+  file << "num_threads\t" << lda->num_threads << endl;
+  file << "thread_utilization\t" << lda->utilization << endl;
+  file << "perplexity\t" << pp << endl;
+  for(map<string, double>::const_iterator i = lda->timings.begin(); i != lda->timings.end(); ++i) {
+    file << "time." << i->first << "\t" << i->second << endl;
+  }
+  file << "tokens_per_sec.sample_topics\t" << num_tokens / lda->timings["sample_topics"] << endl;
+  file << "tokens_per_sec.sample\t" << num_tokens / sample_time << endl;
+}
+
+int
+main(int argc, char *argv[]) {
+  string results_file = "bench.tsv";
+  string out_base = "";
+  int num_topics = 10;
+  double alpha = 1.0;
+  double beta = 0.01;
+  int num_steps = 10;
+  int seed = 0;
+  string dnf_file = "";
+  double eta = 10;
+  bool grouped = false;
+  bool word_major = false;
+  bool compact = false;
+  bool compact_words = false;
+  int num_threads = 1;
+  bool help = false;
+
+  int result;
+  while((result=getopt(argc, argv, "r:o:n:a:b:m:s:d:e:gwkVt:h")) != -1){
+    switch(result){
+    case 'r':
+      results_file = optarg;
+      break;
+    case 'o':
+      out_base = optarg;
+      break;
+    case 'n':
+      num_topics = atoi(optarg);
+      break;
+    case 'a':
+      alpha = atof(optarg);
+      break;
+    case 'b':
+      beta = atof(optarg);
+      break;
+    case 'm':
+      num_steps = atoi(optarg);
+      break;
+    case 's':
+      seed = atoi(optarg);
+      break;
+    case 'd':
+      dnf_file = optarg;
+      break;
+    case 'e':
+      eta = atof(optarg);
+      break;
+    case 'g':
+      grouped = true;
+      break;
+    case 'w':
+      word_major = true;
+      break;
+    case 'k':
+      compact = true;
+      break;
+    case 'V':
+      compact_words = true;
+      break;
+    case 't':
+      num_threads = atoi(optarg);
+      break;
+    case 'h':
+      help = true;
+      break;
+    }
+  }
+
+  vector<string> args(&(argv[optind]), &(argv[argc]));
+  if(args.size() == 0 || help == true) {
+    cerr << "usage: ldadf-bench [OPTION..] DATA" << endl;
+    cerr << endl;
+    cerr << "Benchmark of each training phase of ldadf" << endl;
+    cerr << endl;
+    cerr << "examples:" << endl;
+    cerr << "./src/ldadf-bench -n16 -m10 -r out/bench/results.tsv out/bench/zipf.dat" << endl;
+    cerr << "./src/ldadf-bench -n16 -m10 -r out/bench/results.tsv -d out/bench/zipf.dnf out/bench/zipf.dat" << endl;
+    cerr << endl;
+    cerr << "optional arguments" << endl;
+    cerr << "  -r    file to save results (tab-separated name and value)" << endl;
+    cerr << "  -o    output path (prefix for .bench.phi/.theta/.dti/.smp)" << endl;
+    cerr << "  -n    number of topics" << endl;
+    cerr << "  -a    hyperparameter alpha of document-topic distribution theta" << endl;
+    cerr << "  -b    hyperparameter beta of topic-word distribution phi" << endl;
+    cerr << "  -m    number of sampling steps to be timed" << endl;
+    cerr << "  -s    seed of random function" << endl;
+    cerr << "  -d    file (.dnf) including compiled dnf from constraint linkes" << endl;
+    cerr << "  -e    strength parameter eta of constraint links" << endl;
+    cerr << "  -g    sample repeated words in each document from one shared conditional" << endl;
+    cerr << "  -w    sweep tokens word by word instead of document by document" << endl;
+    cerr << "  -k    store counts as 16-bit integers (rows are promoted on overflow)" << endl;
+    cerr << "  -V    remap word ids to those present in the data (outputs keep the ids of the data)" << endl;
+    cerr << "  -t    number of threads sampling topics of token ranges" << endl;
+    cerr << "  -h    print this message" << endl;
+    return 1;
+  }
+
+  string data = args[0];
+
+  LDA *lda = create_lda(data, out_base, num_topics, alpha, beta,
+                        num_steps, 0, 0, false, seed, false,
+                        dnf_file, eta);
+  if(grouped) {
+    lda->set_grouped(true);
+  }
+  if(word_major) {
+    lda->set_word_major(true);
+  }
+  if(compact) {
+    lda->set_compact_counts(true);
+  }
+  if(compact_words) {
+    lda->set_compact_words(true);
+  }
+  if(num_threads > 1) {
+    lda->set_threads(num_threads);
+  }
+  LDABench bench(lda, num_steps);
+  try {
+    bench.run();
+    bench.save_results(results_file);
+  } catch(const exception &e) {
+    cerr << e.what() << endl;
+    delete lda;
+    return 1;
+  }
+  delete lda;
+
+  return 0;
+}
@@ -0,0 +1,196 @@
+#include "chains.h"
+
+#include <cassert>
+#include <cmath>
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+using namespace std;
+
+#include "utils.h"
+using namespace ldautils;
+
+// reusable barrier of a fixed number of threads, where the last arriving
+// thread runs a given function before the others are released
+class StepBarrier {
+ public:
+  StepBarrier(int num_threads) : num_threads(num_threads), count(0), generation(0) {};
+
+  template <typename F>
+  void wait(F last) {
+    unique_lock<mutex> lock(m);
+    int gen = generation;
+    if(++count == num_threads) {
+      last();
+      count = 0;
+      ++generation;
+      cv.notify_all();
+    } else {
+      cv.wait(lock, [&] { return gen != generation; });
+    }
+  }
+
+ private:
+  mutex m;
+  condition_variable cv;
+  int num_threads;
+  int count;
+  int generation;
+};
+
+const size_t MIN_RHAT_STEPS = 10; // steps after burn-in before checking R-hat
+
+LDAChains::LDAChains(const vector<LDA*> &chains_, double rhat_limit_)
+  : chains(chains_),
+    rhat_limit(rhat_limit_),
+    num_steps(0),
+    stopped(false) {
+  assert(chains.size() > 0);
+}
+
+void
+LDAChains::run() {
+  initialize();
+
+  int num_chains = chains.size();
+  StepBarrier barrier(num_chains);
+  vector<exception_ptr> errors(num_chains);
+  vector<thread> threads;
+  for(int c = 0; c < num_chains; ++c) {
+    threads.push_back(thread([this, c, &barrier, &errors] {
+      LDA *lda = chains[c];
+      try {
+        set_seed(static_cast<unsigned>(lda->rand_seed)); // per-thread generator
+        double start = get_time();
+        lda->preprocess();
+        lda->timings["preprocess"] += get_time() - start;
+      } catch(...) {
+        errors[c] = current_exception();
+      }
+
+      for(int i = 0; i < lda->max_steps; ++i) {
+        if(!errors[c]) {
+          try {
+            run_chain(c, i);
+          } catch(...) {
+            errors[c] = current_exception();
+          }
+        }
+        // every chain has finished step i
+        barrier.wait([&] {
+          for(size_t j = 0; j < errors.size(); ++j) {
+            if(errors[j]) stopped = true;
+          }
+          if(!stopped) check_convergence(i);
+          ++num_steps;
+        });
+        if(stopped) break;
+      }
+    }));
+  }
+  for(int c = 0; c < num_chains; ++c) {
+    threads[c].join();
+  }
+  for(int c = 0; c < num_chains; ++c) {
+    if(errors[c]) rethrow_exception(errors[c]);
+  }
+
+  save_params();
+  comment("* Finish");
+}
+
+void
+LDAChains::initialize() {
+  // corpus loaded once by the first chain and shared with the others
+  int num_chains = chains.size();
+  chains[0]->initialize();
+  for(int c = 1; c < num_chains; ++c) {
+    chains[c]->share_data(*chains[0]);
+    chains[c]->initialize();
+  }
+  pps.assign(num_chains, 0.0);
+  step_lls.assign(num_chains, 0.0);
+  lls.assign(num_chains, vector<double>());
+  rhats.clear();
+  num_steps = 0;
+  stopped = false;
+}
+
+void
+LDAChains::run_chain(int c, int step) {
+  // one step of LDA::infer() in chain c, traced by the log-likelihood tracked in sampling
+  LDA *lda = chains[c];
+  lda->resample();
+  lda->finish_step(step, lda->burn_in, true);
+  step_lls[c] = lda->get_log_likelihood();
+}
+
+void
+LDAChains::check_convergence(int step) {
+  // called by one thread while all chains wait
+  int num_chains = chains.size();
+  LDA *lda = chains[0];
+  string ll_str;
+  for(int c = 0; c < num_chains; ++c) {
+    ll_str += (c > 0 ? " " : "") + str(step_lls[c]);
+  }
+
+  if(step < lda->burn_in) {
+    comment("- step " + str(step) + ": ll = " + ll_str);
+    return;
+  }
+  for(int c = 0; c < num_chains; ++c) {
+    lls[c].push_back(step_lls[c]);
+  }
+  if(num_chains < 2 || lls[0].size() < MIN_RHAT_STEPS) {
+    comment("- step " + str(step) + ": ll = " + ll_str);
+    return;
+  }
+  rhats.push_back(rhat(lls));
+  comment("- step " + str(step) + ": ll = " + ll_str + ", rhat = " + str(rhats.back()));
+
+  if(lda->converge && rhats.back() < rhat_limit) {
+    comment("- converged"); // chains are mixed on log-likelihood
+    stopped = true;
+  }
+}
+
+void
+LDAChains::save_params() {
+  // best chain by the final perplexity, and the trace of all chains
+  int num_chains = chains.size();
+  for(int c = 0; c < num_chains; ++c) {
+    double start = get_time();
+    pps[c] = chains[c]->calc_perplexity();
+    chains[c]->timings["perplexity"] += get_time() - start;
+  }
+  int best = 0;
+  for(int c = 1; c < num_chains; ++c) {
+    if(pps[c] < pps[best]) best = c;
+  }
+  comment("- best chain: " + str(best));
+
+  LDA *lda = chains[best];
+  if(lda->out_base == "") return;
+  double start = get_time();
+  lda->save_params(lda->out_base + ".final");
+  lda->timings["save_params"] += get_time() - start;
+
+  string chains_file = lda->out_base + ".chains";
+  ofstream file(chains_file.c_str());
+  if(!file.is_open()) {
+    throw runtime_error(string("LDAChains::save_params(): cannot open ") + chains_file);
+  }
+  file << "chain\tseed\tperplexity" << endl;
+  for(int c = 0; c < num_chains; ++c) {
+    file << c << "\t" << chains[c]->rand_seed << "\t" << pps[c] << endl;
+  }
+  file << "best\t" << best << endl;
+  file << "num_steps\t" << num_steps << endl;
+  if(!rhats.empty()) {
+    file << "rhat\t" << rhats.back() << endl;
+  }
+}
@@ -0,0 +1,36 @@
+#ifndef CHAINS_H
+#define CHAINS_H
+
+#include <string>
+#include <vector>
+
+#include "lda.h"
+
+// independent samplers run in threads over one shared corpus, stopped by
+// the potential scale reduction factor (R-hat) on log-likelihood across chains
+class LDAChains {
+  friend class TestLDAChains;
+
+ public:
+  LDAChains(const std::vector<LDA*> &chains, double rhat_limit = 1.1);
+
+  void run();
+
+ protected:
+  void initialize();
+  void run_chain(int c, int step);
+  void check_convergence(int step);
+  void save_params();
+
+ protected:
+  std::vector<LDA*> chains;
+  double rhat_limit;
+  int num_steps; // steps done by all chains
+  bool stopped;
+  std::vector<double> pps; // pps[c] = perplexity of chain c after the last step
+  std::vector<double> step_lls; // step_lls[c] = log-likelihood of chain c in the last step
+  std::vector<std::vector<double> > lls; // lls[c][i] = log-likelihood of chain c in i-th step after burn-in
+  std::vector<double> rhats; // rhats[i] = R-hat of log-likelihood after i-th step
+};
+
+#endif
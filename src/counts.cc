@@ -0,0 +1,83 @@
+#include "counts.h"
+
+#include <stdexcept>
+using namespace std;
+
+const size_t CountMatrix::NARROW;
+const int CountMatrix::MAX_NARROW;
+
+void
+CountMatrix::assign(int num_rows_, int num_cols_, bool compact_) {
+  num_rows = num_rows_;
+  num_cols = num_cols_;
+  compact = compact_;
+  wide_index.assign(num_rows, NARROW);
+  narrow.clear();
+  wide.clear();
+  if(compact) {
+    narrow.assign((size_t)num_rows * num_cols, 0);
+  } else {
+    wide.assign((size_t)num_rows * num_cols, 0);
+    for(int r = 0; r < num_rows; ++r) {
+      wide_index[r] = (size_t)r * num_cols;
+    }
+  }
+  narrow.shrink_to_fit();
+  wide.shrink_to_fit();
+}
+
+int
+CountMatrix::num_promoted() const {
+  if(!compact) return 0;
+  return wide.size() / (num_cols > 0 ? num_cols : 1);
+}
+
+size_t
+CountMatrix::bytes() const {
+  return narrow.size() * sizeof(uint16_t) + wide.size() * sizeof(int) + wide_index.size() * sizeof(size_t);
+}
+
+void
+CountMatrix::set(int r, int c, int value) {
+  if(value < 0) {
+    throw invalid_argument("CountMatrix::set(): negative count");
+  }
+  if(wide_index[r] == NARROW && value > MAX_NARROW) {
+    promote(r);
+  }
+  size_t i = wide_index[r];
+  if(i == NARROW) {
+    narrow[(size_t)r * num_cols + c] = value;
+  } else {
+    wide[i + c] = value;
+  }
+}
+
+int
+CountMatrix::row_sum(int r) const {
+  int s = 0;
+  for(int c = 0; c < num_cols; ++c) {
+    s += get(r, c);
+  }
+  return s;
+}
+
+void
+CountMatrix::to_vector(vector<vector<int> > &mat) const {
+  mat.assign(num_rows, vector<int>(num_cols));
+  for(int r = 0; r < num_rows; ++r) {
+    for(int c = 0; c < num_cols; ++c) {
+      mat[r][c] = get(r, c);
+    }
+  }
+}
+
+void
+CountMatrix::promote(int r) {
+  // rows are appended to wide and stay there; the narrow slots are left unused
+  assert(wide_index[r] == NARROW);
+  size_t i = wide.size();
+  const uint16_t *x = &narrow[(size_t)r * num_cols];
+  wide.insert(wide.end(), x, x + num_cols);
+  wide_index[r] = i;
+}
@@ -0,0 +1,86 @@
+#ifndef COUNTS_H
+#define COUNTS_H
+
+#include <cassert>
+#include <cstddef>
+#include <stdint.h>
+
+#include <vector>
+
+// matrix of non-negative counts, optionally stored as uint16_t (compact mode)
+// where a row is promoted to int when one of its counts overflows
+class CountMatrix {
+  friend class TestCountMatrix;
+
+ public:
+  CountMatrix() : num_rows(0), num_cols(0), compact(false) {};
+
+  void assign(int num_rows, int num_cols, bool compact = false); // all zero
+
+  int size() const { return num_rows; }
+  int cols() const { return num_cols; }
+  bool is_compact() const { return compact; }
+  bool is_promoted(int r) const { return compact && wide_index[r] != NARROW; }
+  int num_promoted() const; // number of rows promoted to int
+  size_t bytes() const; // memory of counts
+
+  int get(int r, int c) const {
+    size_t i = wide_index[r];
+    return i == NARROW ? narrow[(size_t)r * num_cols + c] : wide[i + c];
+  }
+  void set(int r, int c, int value);
+  void inc(int r, int c) {
+    size_t i = wide_index[r];
+    if(i != NARROW) {
+      ++wide[i + c];
+      return;
+    }
+    uint16_t &x = narrow[(size_t)r * num_cols + c];
+    if(x == MAX_NARROW) {
+      promote(r);
+      ++wide[wide_index[r] + c];
+      return;
+    }
+    ++x;
+  }
+  void dec(int r, int c) {
+    size_t i = wide_index[r];
+    if(i != NARROW) {
+      --wide[i + c];
+      return;
+    }
+    uint16_t &x = narrow[(size_t)r * num_cols + c];
+    assert(x > 0);
+    --x;
+  }
+
+  // row r as ints, widened into buf (of cols() ints) if it is stored as uint16_t
+  const int *row(int r, int *buf) const {
+    size_t i = wide_index[r];
+    if(i != NARROW) return &wide[i];
+    const uint16_t *x = &narrow[(size_t)r * num_cols];
+    int n = num_cols; // local, as buf may alias num_cols
+    for(int c = 0; c < n; ++c) {
+      buf[c] = x[c];
+    }
+    return buf;
+  }
+  int row_sum(int r) const;
+  void to_vector(std::vector<std::vector<int> > &mat) const;
+
+ protected:
+  void promote(int r);
+
+ protected:
+  static const size_t NARROW = (size_t)-1;
+  static const int MAX_NARROW = 65535;
+
+  int num_rows;
+  int num_cols;
+  bool compact;
+  std::vector<size_t> wide_index; // wide_index[r] = offset of row r in wide, or NARROW if in narrow
+  std::vector<uint16_t> narrow; // narrow[r * num_cols + c] (compact mode only)
+  std::vector<int> wide; // promoted rows (all rows if not compact)
+};
+
+#endif
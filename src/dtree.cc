@@ -6,6 +6,7 @@
 
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <sstream>
 using namespace std;
 
@@ -19,7 +20,9 @@ DTree::parse(const string &line) {
   
   vector<string> conj;
   split(line, ';', conj);
-  assert(conj.size() == 2);
+  if(conj.size() != 2) {
+    throw runtime_error(string("DTree::parse(): expected eps;np but ") + line);
+  }
 
   string eps_str = conj[0];
   string np_str = conj[1];
@@ -28,21 +31,52 @@ DTree::parse(const string &line) {
 }
 
 DTree::PrimType
-DTree::get_type(int w) {
-  if(prim_type.count(w) > 0) {
-    return prim_type[w]; // Ep or Np
+DTree::get_type(int w) const {
+  map<int, PrimType>::const_iterator i = prim_type.find(w);
+  if(i != prim_type.end()) {
+    return i->second; // Ep or Np
   }
   return None;
 }
 
 int
-DTree::get_ep(int w) {
+DTree::get_ep(int w) const {
   assert(ep_idx.count(w) > 0);
-  return ep_idx[w];
+  return ep_idx.find(w)->second;
+}
+
+void
+DTree::remap(const vector<int> &index) {
+  // word w to index[w], dropping words out of index (-1) and eps left empty
+  ep_idx.clear();
+  prim_type.clear();
+  vector<vector<int> > old_eps;
+  old_eps.swap(eps);
+  for(size_t e = 0; e < old_eps.size(); ++e) {
+    vector<int> ep;
+    for(size_t i = 0; i < old_eps[e].size(); ++i) {
+      int w = old_eps[e][i];
+      if(w < (int)index.size() && index[w] >= 0) {
+        ep.push_back(index[w]);
+        prim_type[index[w]] = Ep;
+        ep_idx[index[w]] = eps.size();
+      }
+    }
+    if(ep.size() > 0) eps.push_back(ep);
+  }
+  vector<int> old_np;
+  old_np.swap(np);
+  for(size_t i = 0; i < old_np.size(); ++i) {
+    int w = old_np[i];
+    if(w < (int)index.size() && index[w] >= 0) {
+      np.push_back(index[w]);
+      prim_type[index[w]] = Np;
+    }
+  }
 }
 
 string
-DTree::str() {
+DTree::str() const {
   ostringstream ss;
   bool conj_flag = false;
   for(vector<vector<int> >::const_iterator i = eps.begin(); i != eps.end(); ++i) {
@@ -94,8 +128,7 @@ DTree::parse_words(const string &words_str, vector<int> &words, DTree::PrimType
     if(*i == "") continue;
     int w = atoi(i->c_str());
     if (w == 0 && *i != "0") {
-      cerr << "DTree::parse_words(): unknown character " << *i << endl;
-      exit(1);
+      throw runtime_error(string("DTree::parse_words(): unknown character ") + *i);
     }
     words.push_back(w);
     prim_type[w] = type;
@@ -13,9 +13,10 @@ class DTree {
   DTree() {};
 
   void parse(const std::string &line);
-  PrimType get_type(int w);
-  int get_ep(int w);
-  std::string str();
+  PrimType get_type(int w) const;
+  int get_ep(int w) const;
+  void remap(const std::vector<int> &index); // index[w] = new id of word w, or -1 to drop it
+  std::string str() const;
 
   std::vector<std::vector<int> > eps; // eps[e] = words in e-th ep
   std::vector<int> np; // words in np
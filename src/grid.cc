@@ -0,0 +1,131 @@
+#include "grid.h"
+
+#include <cassert>
+
+#include <exception>
+#include <fstream>
+#include <stdexcept>
+using namespace std;
+
+#include "heldout.h"
+#include "ldadf.h"
+#include "scheduler.h"
+#include "utils.h"
+using namespace ldautils;
+
+LDAGrid::LDAGrid(const vector<LDA*> &configs_, int num_threads_, const string &summary_file_)
+  : configs(configs_),
+    num_threads(num_threads_ > 0 ? num_threads_ : 1),
+    summary_file(summary_file_),
+    heldout_file(""),
+    heldout_samples(10),
+    heldout_completion(false) {
+  assert(configs.size() > 0);
+}
+
+void
+LDAGrid::set_heldout(const string &heldout_file_, int num_samples, bool completion) {
+  heldout_file = heldout_file_;
+  heldout_samples = num_samples;
+  heldout_completion = completion;
+}
+
+void
+LDAGrid::run() {
+  // corpus loaded once by the first configuration, and shared with the others in their threads
+  int num_configs = configs.size();
+  double start = get_time();
+  configs[0]->initialize();
+  double load_time = get_time() - start;
+  pps.assign(num_configs, 0.0);
+  seconds.assign(num_configs, 0.0);
+  heldout_pps.assign(num_configs, 0.0);
+  seconds[0] = load_time;
+
+  // longest first by topics x steps
+  vector<long> weights(num_configs);
+  for(int k = 0; k < num_configs; ++k) {
+    weights[k] = (long)configs[k]->num_topics * configs[k]->max_steps;
+  }
+  vector<exception_ptr> errors(num_configs);
+  TaskScheduler scheduler(weights, min(num_threads, num_configs));
+  scheduler.run([&](int, int k) {
+      try {
+        run_config(k);
+      } catch(...) {
+        errors[k] = current_exception();
+      }
+    });
+  for(int k = 0; k < num_configs; ++k) {
+    if(errors[k]) rethrow_exception(errors[k]);
+  }
+
+  save_summary();
+  comment("* Finish");
+}
+
+void
+LDAGrid::run_config(int k) {
+  // LDA::run() in a thread of the pool
+  LDA *lda = configs[k];
+  double start = get_time();
+  if(k > 0) {
+    lda->share_data(*configs[0]);
+    lda->initialize();
+  }
+  set_seed(static_cast<unsigned>(lda->rand_seed)); // per-thread generator
+  double preprocess_start = get_time();
+  lda->preprocess();
+  lda->timings["preprocess"] += get_time() - preprocess_start;
+  lda->infer();
+  pps[k] = lda->calc_perplexity();
+  seconds[k] += get_time() - start;
+
+  if(heldout_file != "") { // in the thread of the configuration, which is not timed
+    LDAHeldout heldout(*lda, heldout_samples, lda->rand_seed);
+    heldout.set_completion(heldout_completion);
+    heldout.load_data(heldout_file);
+    heldout_pps[k] = heldout.run();
+    heldout.save_results(lda->out_base + ".heldout");
+  }
+}
+
+void
+LDAGrid::save_summary() {
+  // final perplexity and elapsed seconds of each configuration, and the best one
+  // (by held-out perplexity if evaluated)
+  int num_configs = configs.size();
+  const vector<double> &scores = heldout_file != "" ? heldout_pps : pps;
+  int best = 0;
+  for(int k = 1; k < num_configs; ++k) {
+    if(scores[k] < scores[best]) best = k;
+  }
+  comment("- best configuration: " + str(best));
+  if(summary_file == "") return;
+
+  ofstream file(summary_file.c_str());
+  if(!file.is_open()) {
+    throw runtime_error(string("LDAGrid::save_summary(): cannot open ") + summary_file);
+  }
+  file << "config\tnum_topics\talpha\tbeta\teta\tperplexity\tseconds\tout_base";
+  if(heldout_file != "") {
+    file << "\theldout";
+  }
+  file << endl;
+  for(int k = 0; k < num_configs; ++k) {
+    LDA *lda = configs[k];
+    LDADF *ldadf = dynamic_cast<LDADF*>(lda);
+    file << k << "\t" << lda->num_topics << "\t" << lda->alpha << "\t" << lda->beta << "\t";
+    if(ldadf) {
+      file << ldadf->eta;
+    } else {
+      file << "-";
+    }
+    file << "\t" << pps[k] << "\t" << seconds[k] << "\t" << lda->out_base;
+    if(heldout_file != "") {
+      file << "\t" << heldout_pps[k];
+    }
+    file << endl;
+  }
+  file << "best\t" << best << endl;
+}
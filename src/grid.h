@@ -0,0 +1,37 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <string>
+#include <vector>
+
+#include "lda.h"
+
+// configurations (e.g. of hyperparameters) trained concurrently on a pool of
+// threads over one corpus (and dnf) loaded once, with a summary of their results
+class LDAGrid {
+  friend class TestLDAGrid;
+
+ public:
+  LDAGrid(const std::vector<LDA*> &configs, int num_threads = 1, const std::string &summary_file = "");
+
+  void set_heldout(const std::string &heldout_file, int num_samples = 10, bool completion = false);
+
+  void run();
+
+ protected:
+  void run_config(int k);
+  void save_summary();
+
+ protected:
+  std::vector<LDA*> configs;
+  int num_threads;
+  std::string summary_file; // tab-separated results of configurations (disabled if empty)
+  std::string heldout_file; // documents to evaluate each configuration on (disabled if empty)
+  int heldout_samples; // particles (or sweeps) of LDAHeldout
+  bool heldout_completion;
+  std::vector<double> pps; // pps[k] = final perplexity of k-th configuration
+  std::vector<double> seconds; // seconds[k] = elapsed seconds of k-th configuration
+  std::vector<double> heldout_pps; // heldout_pps[k] = held-out perplexity of k-th configuration
+};
+
+#endif
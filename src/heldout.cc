@@ -0,0 +1,268 @@
+#include "heldout.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+using namespace std;
+
+#include "scheduler.h"
+#include "utils.h"
+using namespace ldautils;
+
+LDAHeldout::LDAHeldout(LDA &model, int num_samples_, int rand_seed_)
+  : num_topics(model.num_topics),
+    num_samples(num_samples_),
+    rand_seed(rand_seed_),
+    num_threads(1),
+    completion(false),
+    alphas(model.alphas),
+    word_index(model.word_index),
+    num_unknown(0),
+    utilization(1.0) {
+  assert(num_samples > 0);
+  vector<vector<double> > phi(num_topics, vector<double>(model.num_words));
+  model.get_mean_phi(phi);
+  set_phi(phi);
+}
+
+LDAHeldout::LDAHeldout(const string &model_base, double alpha, int num_samples_, int rand_seed_)
+  : num_samples(num_samples_),
+    rand_seed(rand_seed_),
+    num_threads(1),
+    completion(false),
+    num_unknown(0),
+    utilization(1.0) {
+  assert(num_samples > 0);
+  // dense .phi has a row per word, and sparse one a row per topic
+  string phi_file = model_base + ".phi";
+  comment("- loading " + phi_file);
+  ifstream in(phi_file.c_str());
+  string line;
+  bool sparse = in.is_open() && getline(in, line) && line.find(':') != string::npos;
+  vector<vector<double> > phi;
+  load_matrix(phi_file, phi);
+  if(!sparse) {
+    vector<vector<double> > tphi;
+    transpose(phi, tphi);
+    phi.swap(tphi);
+  }
+  if(phi.empty()) {
+    throw runtime_error("LDAHeldout::LDAHeldout(): " + phi_file + " has no topics");
+  }
+  num_topics = phi.size();
+  alphas.assign(num_topics, alpha);
+  set_phi(phi);
+}
+
+void
+LDAHeldout::set_phi(const vector<vector<double> > &phi) {
+  // word-major, so that the topics of a term are contiguous
+  num_words = phi[0].size();
+  phi_wz.assign(num_words * num_topics, 0.0);
+  for(int z = 0; z < num_topics; ++z) {
+    for(int w = 0; w < num_words; ++w) {
+      phi_wz[w * num_topics + z] = phi[z][w];
+    }
+  }
+  sum_alpha = sum(alphas);
+  comment("# held-out topics: " + str(num_topics));
+}
+
+void
+LDAHeldout::set_threads(int num_threads_) {
+  num_threads = num_threads_ > 0 ? num_threads_ : 1;
+}
+
+void
+LDAHeldout::set_completion(bool completion_) {
+  completion = completion_;
+}
+
+void
+LDAHeldout::load_data(const string &file_name) {
+  ifstream in(file_name.c_str());
+  if(!in.is_open()) {
+    throw runtime_error(string("LDAHeldout::load_data(): cannot open ") + file_name);
+  }
+
+  docs.clear();
+  num_unknown = 0;
+  string line;
+  vector<int> doc;
+  vector<string> wfs; // ("word:freq", "word2:freq2", ...)
+  while(getline(in, line)) {
+    split(line, ' ', wfs);
+    doc.clear();
+    for(vector<string>::iterator s = wfs.begin(); s != wfs.end(); ++s) {
+      if(*s == "") continue;
+      int wid, freq;
+      parse_word_freq(*s, wid, freq);
+      int w = -1;
+      if(word_index.empty()) {
+        w = wid < num_words ? wid : -1;
+      } else if(wid < (int)word_index.size()) {
+        w = word_index[wid];
+      }
+      double mass = 0.0;
+      for(int z = 0; w >= 0 && z < num_topics; ++z) {
+        mass += phi_wz[w * num_topics + z];
+      }
+      if(mass <= 0.0) {
+        num_unknown += freq;
+        continue;
+      }
+      for(int j = 0; j < freq; ++j) {
+        doc.push_back(w);
+      }
+    }
+    docs.push_back(doc);
+  }
+  comment("# held-out docs: " + str((int)docs.size()));
+  comment("# unknown terms: " + str(num_unknown));
+}
+
+double
+LDAHeldout::run() {
+  // each document with its own seed, so that results do not depend on threads
+  int num_docs = docs.size();
+  log_liks.assign(num_docs, 0.0);
+  num_heldout.assign(num_docs, 0);
+  vector<long> weights(num_docs);
+  for(int d = 0; d < num_docs; ++d) {
+    long n = docs[d].size();
+    weights[d] = completion ? n : n * n; // left-to-right resamples all previous terms
+  }
+  vector<vector<double> > cums(num_threads, vector<double>(num_topics));
+  TaskScheduler scheduler(weights, num_threads);
+  double start = get_time();
+  scheduler.run([&](int t, int d) {
+      set_seed(static_cast<unsigned>(rand_seed + d));
+      log_liks[d] = completion ? calc_completion(d, cums[t]) : calc_left_to_right(d, cums[t]);
+    });
+  utilization = scheduler.get_utilization();
+
+  double lik = 0.0;
+  long num_terms = 0;
+  for(int d = 0; d < num_docs; ++d) {
+    lik += log_liks[d];
+    num_terms += num_heldout[d];
+  }
+  double seconds = get_time() - start;
+  comment("# held-out terms: " + str(num_terms));
+  comment("- held-out terms per sec: " + str(seconds > 0.0 ? num_terms / seconds : 0.0));
+  if(num_terms == 0) {
+    throw runtime_error("LDAHeldout::run(): no held-out terms");
+  }
+  return exp(-lik / num_terms);
+}
+
+int
+LDAHeldout::sample(int w, const vector<int> &cz, vector<double> &cum) {
+  // from (cz[z] + alpha_z) * phi[z][w], leaving the total weight in cum.back()
+  const double *phi_w = &phi_wz[w * num_topics];
+  double s = 0.0;
+  for(int z = 0; z < num_topics; ++z) {
+    s += (cz[z] + alphas[z]) * phi_w[z];
+    cum[z] = s;
+  }
+  return multi_cum(cum.data(), num_topics);
+}
+
+double
+LDAHeldout::calc_left_to_right(int d, vector<double> &cum) {
+  // Wallach et al. (2009): p(w_i | w_<i) averaged over particles, each of which
+  // resamples the topics of the previous terms before sampling the topic of w_i
+  const vector<int> &doc = docs[d];
+  int n = doc.size();
+  vector<double> probs(n, 0.0);
+  vector<int> hz(n);
+  vector<int> cz(num_topics);
+  for(int r = 0; r < num_samples; ++r) {
+    cz.assign(num_topics, 0);
+    for(int i = 0; i < n; ++i) {
+      for(int j = 0; j < i; ++j) {
+        --cz[hz[j]];
+        hz[j] = sample(doc[j], cz, cum);
+        ++cz[hz[j]];
+      }
+      hz[i] = sample(doc[i], cz, cum);
+      probs[i] += cum[num_topics - 1] / (i + sum_alpha);
+      ++cz[hz[i]];
+    }
+  }
+  double lik = 0.0;
+  for(int i = 0; i < n; ++i) {
+    lik += log(probs[i] / num_samples);
+  }
+  num_heldout[d] = n;
+  return lik;
+}
+
+double
+LDAHeldout::calc_completion(int d, vector<double> &cum) {
+  // the first half of the terms in a random order (by the seed of the document) is
+  // observed and the rest held out, given theta averaged over the latter half of the
+  // sweeps; terms are shuffled, as those of a word are consecutive in .dat
+  vector<int> doc(docs[d]);
+  shuffle(doc.begin(), doc.end(), mt19937(draw_seed()));
+  int n = doc.size();
+  int num_observed = (n + 1) / 2;
+  vector<int> hz(num_observed);
+  vector<int> cz(num_topics, 0);
+  for(int i = 0; i < num_observed; ++i) {
+    hz[i] = sample(doc[i], cz, cum);
+    ++cz[hz[i]];
+  }
+  int burn_in = num_samples / 2;
+  vector<double> theta(num_topics, 0.0);
+  for(int s = 0; s < num_samples; ++s) {
+    for(int i = 0; i < num_observed; ++i) {
+      --cz[hz[i]];
+      hz[i] = sample(doc[i], cz, cum);
+      ++cz[hz[i]];
+    }
+    if(s < burn_in) continue;
+    for(int z = 0; z < num_topics; ++z) {
+      theta[z] += (cz[z] + alphas[z]) / (num_observed + sum_alpha);
+    }
+  }
+  for(int z = 0; z < num_topics; ++z) {
+    theta[z] /= num_samples - burn_in;
+  }
+
+  double lik = 0.0;
+  for(int i = num_observed; i < n; ++i) {
+    const double *phi_w = &phi_wz[doc[i] * num_topics];
+    double prob = 0.0;
+    for(int z = 0; z < num_topics; ++z) {
+      prob += theta[z] * phi_w[z];
+    }
+    lik += log(prob);
+  }
+  num_heldout[d] = n - num_observed;
+  return lik;
+}
+
+void
+LDAHeldout::save_results(const string &file_name) {
+  ofstream file(file_name.c_str());
+  if(!file.is_open()) {
+    throw runtime_error(string("LDAHeldout::save_results(): cannot open ") + file_name);
+  }
+  double lik = 0.0;
+  long num_terms = 0;
+  file << "doc\tlog_likelihood\tnum_terms" << endl;
+  for(size_t d = 0; d < log_liks.size(); ++d) {
+    file << d << "\t" << log_liks[d] << "\t" << num_heldout[d] << endl;
+    lik += log_liks[d];
+    num_terms += num_heldout[d];
+  }
+  file << "perplexity\t" << (num_terms > 0 ? exp(-lik / num_terms) : 0.0) << endl;
+  file << "unknown_terms\t" << num_unknown << endl;
+  file << "method\t" << (completion ? "completion" : "left-to-right") << endl;
+}
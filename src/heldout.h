@@ -0,0 +1,57 @@
+#ifndef HELDOUT_H
+#define HELDOUT_H
+
+#include <string>
+#include <vector>
+
+#include "lda.h"
+
+// log-likelihood of held-out documents given the fixed phi of a trained model (for
+// LDA-DF, normalized weights of the trees assigned to topics), estimated in parallel
+// across documents by left-to-right particles or by document completion
+class LDAHeldout {
+  friend class TestLDAHeldout;
+
+ public:
+  LDAHeldout(LDA &model, int num_samples = 10, int rand_seed = 0); // phi and alphas of a trained model
+  LDAHeldout(const std::string &model_base, double alpha, int num_samples = 10, int rand_seed = 0); // .phi
+
+  void set_threads(int num_threads);
+  void set_completion(bool completion);
+
+  void load_data(const std::string &file_name); // documents in word ids of the model data
+  double run(); // perplexity of held-out tokens
+  void save_results(const std::string &file_name);
+
+ protected:
+  void set_phi(const std::vector<std::vector<double> > &phi); // phi[z][w]
+  double calc_left_to_right(int d, std::vector<double> &cum);
+  double calc_completion(int d, std::vector<double> &cum);
+  int sample(int w, const std::vector<int> &cz, std::vector<double> &cum);
+
+ protected:
+  // arguments
+  int num_topics;
+  int num_samples; // particles of left-to-right, or sweeps of document completion
+  int rand_seed;
+  int num_threads;
+  bool completion; // document completion instead of left-to-right
+
+  // model
+  int num_words;
+  std::vector<double> phi_wz; // phi_wz[w * num_topics + z] = phi[z][w]
+  std::vector<double> alphas;
+  double sum_alpha;
+  std::vector<int> word_index; // word_index[id] = word of word id in the test data, or -1 if missing (only if remapped)
+
+  // docs
+  std::vector<std::vector<int> > docs; // docs[d][i] = word of i-th known term in document d
+  int num_unknown; // terms of words without probability in the model, which are skipped
+
+  // results
+  std::vector<double> log_liks; // log_liks[d] = log-likelihood of held-out terms of document d
+  std::vector<int> num_heldout; // num_heldout[d] = number of held-out terms of document d
+  double utilization; // of threads in the last run()
+};
+
+#endif
@@ -6,8 +6,10 @@
 
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 using namespace std;
 
+#include "scheduler.h"
 #include "utils.h"
 using namespace ldautils;
 
@@ -24,7 +26,29 @@ LDA::LDA(string data_file_, string out_base_, int num_topics_, double alpha_, do
    burn_in(burn_in_),
    converge(converge_),
    rand_seed(rand_seed_),
-   verbose(verbose_) {
+   verbose(verbose_),
+   grouped(false),
+   word_major(false),
+   average_every(0),
+   compact_counts(false),
+   compact_word_ids(false),
+   sparse_top_k(0),
+   sparse_threshold(0.0),
+   old_rate(1.0),
+   save_hz(false),
+   conditional_init(false),
+   time_budget(0.0),
+   start_time(0.0),
+   num_old_docs(0),
+   old_begin(0),
+   old_window(0),
+   num_samples(0),
+   log_lik(0.0),
+   lik_ratio(1.0),
+   num_threads(1),
+   chunk_size(10000),
+   utilization(1.0),
+   num_changes(0) {
 
   assert(num_topics > 0);
   assert(alpha > 0.0);
@@ -50,112 +74,460 @@ LDA::LDA(string data_file_, string out_base_, int num_topics_, double alpha_, do
   comment("- verbose: " + str(verbose));
 }
 
+void
+LDA::set_metrics_file(const string &file) {
+  metrics_file = file;
+  comment("- metrics file: " + metrics_file);
+}
+
+void
+LDA::set_grouped(bool grouped_) {
+  grouped = grouped_;
+  comment("- grouped: " + str(grouped));
+}
+
+void
+LDA::set_word_major(bool word_major_) {
+  word_major = word_major_;
+  comment("- word major: " + str(word_major));
+}
+
+void
+LDA::set_average_every(int every) {
+  average_every = every;
+  comment("- average every: " + str(average_every));
+}
+
+void
+LDA::set_compact_counts(bool compact) {
+  compact_counts = compact;
+  comment("- compact counts: " + str(compact_counts));
+}
+
+void
+LDA::set_compact_words(bool compact) {
+  compact_word_ids = compact;
+  comment("- compact word ids: " + str(compact_word_ids));
+}
+
+void
+LDA::set_sparse_output(int top_k, double threshold) {
+  sparse_top_k = top_k > 0 ? top_k : 0;
+  sparse_threshold = threshold > 0.0 ? threshold : 0.0;
+  comment("- sparse top-k: " + str(sparse_top_k));
+  comment("- sparse threshold: " + str(sparse_threshold));
+}
+
+void
+LDA::set_warm_start(const string &prior_base) {
+  warm_start_base = prior_base;
+  comment("- warm start: " + warm_start_base);
+}
+
+void
+LDA::set_resume(const string &state_base, const string &append_file_, double old_rate_) {
+  resume_base = state_base;
+  append_file = append_file_;
+  old_rate = old_rate_ > 0.0 ? min(old_rate_, 1.0) : 1.0;
+  comment("- resume: " + resume_base);
+  comment("- append: " + append_file);
+  comment("- rate of old docs: " + str(old_rate));
+}
+
+void
+LDA::set_save_state(bool save) {
+  save_hz = save;
+  comment("- save state: " + str(save_hz));
+}
+
+void
+LDA::set_conditional_init(bool conditional) {
+  conditional_init = conditional;
+  comment("- conditional init: " + str(conditional_init));
+}
+
+void
+LDA::set_time_budget(double seconds) {
+  time_budget = seconds > 0.0 ? seconds : 0.0;
+  comment("- time budget: " + str(time_budget));
+}
+
+void
+LDA::set_threads(int num_threads_, int chunk_size_) {
+  num_threads = num_threads_ > 0 ? num_threads_ : 1;
+  chunk_size = chunk_size_ > 0 ? chunk_size_ : 1;
+  comment("- threads: " + str(num_threads));
+  comment("- chunk size: " + str(chunk_size));
+}
+
 void
 LDA::run() {
   initialize();
+  double start = get_time();
   preprocess();
+  timings["preprocess"] += get_time() - start;
   infer();
 }
 
 void
 LDA::initialize() {
   comment("* Initialization");
-  comment("- loading " + data_file);
-  load_data(data_file);
+  start_time = get_time();
+  if(data_file != "") { // otherwise given by set_data()
+    comment("- loading " + data_file);
+    double start = get_time();
+    load_data(data_file);
+    timings["load_data"] += get_time() - start;
+  }
   
   comment("# docs: " + str(num_docs));
   comment("# words: " + str(num_words));
+  if(!word_ids.empty()) {
+    comment("# word ids: " + str((int)word_index.size()));
+  }
   comment("# terms: " + str(num_terms));
 
-  srand(static_cast<unsigned>(rand_seed));
+  set_seed(static_cast<unsigned>(rand_seed));
 
   cz.assign(num_topics, 0);
-  cdz.assign(num_docs, cz);
-  cwz.assign(num_words, cz);
+  cdz.assign(num_docs, num_topics, compact_counts);
+  cwz.assign(num_words, num_topics, compact_counts);
+  if(compact_counts) {
+    comment("# bytes of counts: " + str((long)(cdz.bytes() + cwz.bytes())));
+  }
   hz.assign(num_docs, vector<int>());
   for(int d = 0; d < num_docs; d++) {
     hz[d].assign(nd[d], 0);
   }
 
+  workers.clear(); // copied from the counts by the first parallel step
+  tasks.clear();
+  num_old_docs = 0; // all documents are swept unless resumed
+
+  word_tokens.clear();
+  if(word_major) {
+    // inverted index of tokens, sorted by (d, i) for each word
+    word_tokens.assign(num_words, vector<pair<int, int> >());
+    for(int d = 0; d < num_docs; d++) {
+      for(int i = 0; i < nd[d]; i++) {
+        word_tokens[(*docs)[d][i]].push_back(make_pair(d, i));
+      }
+    }
+  }
+
   alphas.assign(num_topics, alpha);
   betas.assign(num_words, beta);
 
   probs.assign(num_topics, 0.0);
+  count_rows.assign(2 * num_topics, 0);
   phi.assign(num_topics, vector<double>(num_words));
   theta.assign(num_docs, vector<double>(num_topics));
+
+  num_samples = 0;
+  phi_sum.clear();
+  theta_sum.clear();
+  if(average_every > 0) {
+    phi_sum.assign(num_topics, vector<double>(num_words, 0.0));
+    theta_sum.assign(num_docs, vector<double>(num_topics, 0.0));
+  }
 }
 
 void
 LDA::preprocess() {
   comment("* Preprocessing");
+  if(resume_base != "") {
+    // topics of old documents from the state, and those of new ones sampled in turn given them
+    num_old_docs = load_state(resume_base);
+    init_conditional(num_old_docs);
+    old_window = max(1, static_cast<int>(old_rate * num_old_docs));
+    old_begin = num_old_docs > 0 ? num_old_docs - old_window : 0; // to 0 in the first step
+    comment("# new docs: " + str(num_docs - num_old_docs));
+    sync_log_likelihood();
+    return;
+  }
+  if(warm_start_base != "") {
+    // sample from the conditional of the prior model, given topics of the document so far
+    vector<vector<double> > prior_cwz;
+    vector<double> prior_cz;
+    load_prior(warm_start_base, prior_cwz, prior_cz);
+    vector<double> cum(num_topics);
+    for(int d = 0; d < num_docs; d++) {
+      for(int i = 0; i < nd[d]; i++) {
+        int w = (*docs)[d][i];
+        double s = 0.0;
+        for(int z = 0; z < num_topics; z++) {
+          s += (cdz.get(d, z) + alphas[z]) * (prior_cwz[w][z] + betas[w]) / (prior_cz[z] + beta * num_words);
+          cum[z] = s;
+        }
+        int z = multi_cum(&cum[0], num_topics);
+        resample_post(d, w, z);
+        hz[d][i] = z;
+      }
+    }
+    sync_log_likelihood();
+    return;
+  }
+  if(conditional_init) {
+    init_conditional(0);
+    sync_log_likelihood();
+    return;
+  }
+
   probs.assign(num_topics, 1.0/num_topics);
   for(int d = 0; d < num_docs; d++) {
     for(int i = 0; i < nd[d]; i++) {
-      int w = docs[d][i];
+      int w = (*docs)[d][i];
       int z = multi(probs);
       resample_post(d, w, z);
       hz[d][i] = z;
     }
   }
+  sync_log_likelihood();
+}
+
+void
+LDA::load_prior(const string &prior_base, vector<vector<double> > &prior_cwz, vector<double> &prior_cz) {
+  // counts of .smp (dense or sparse) in word ids of the data, where new words have zeros
+  string smp_file = prior_base + ".smp";
+  comment("- loading " + smp_file);
+  vector<vector<double> > smp; // smp[z][id]
+  load_matrix(smp_file, smp);
+  if((int)smp.size() != num_topics) {
+    throw runtime_error("LDA::load_prior(): " + smp_file + " has " + str((int)smp.size()) +
+                        " topics instead of " + str(num_topics));
+  }
+  prior_cwz.assign(num_words, vector<double>(num_topics, 0.0));
+  prior_cz.assign(num_topics, 0.0);
+  int num_new = 0;
+  for(int w = 0; w < num_words; w++) {
+    size_t id = word_ids.empty() ? w : word_ids[w];
+    bool found = false;
+    for(int z = 0; z < num_topics; z++) {
+      if(id < smp[z].size()) {
+        prior_cwz[w][z] = smp[z][id];
+        found = found || smp[z][id] > 0.0;
+      }
+    }
+    if(!found) ++num_new;
+  }
+  for(int z = 0; z < num_topics; z++) {
+    prior_cz[z] = sum(smp[z]); // including words missing in the data
+  }
+  comment("# words without prior counts: " + str(num_new));
+}
+
+void
+LDA::init_conditional(int first_doc) {
+  // topics of tokens in documents from first_doc, sampled from the conditional of the counts
+  // so far; threads sample shards against their own counts after documents of a share of
+  // tokens are sampled first, so that they start from the same topics
+  if(num_threads == 1) {
+    init_topics(first_doc, num_docs);
+    return;
+  }
+  int d = first_doc;
+  long num_seed_terms = 0;
+  for(; d < num_docs && num_seed_terms < num_terms / (4 * num_threads); d++) {
+    num_seed_terms += nd[d];
+  }
+  init_topics(first_doc, d);
+  if(d < num_docs) {
+    resample_parallel(true, d);
+  }
+}
+
+void
+LDA::init_topics(int begin, int end) {
+  for(int d = begin; d < end; d++) {
+    for(int i = 0; i < nd[d]; i++) {
+      int w = (*docs)[d][i];
+      int z = sample_topic(d, w);
+      resample_post(d, w, z);
+      hz[d][i] = z;
+    }
+  }
+}
+
+int
+LDA::load_state(const string &state_base) {
+  // topics of tokens (.hz) of the leading documents, which are counted as sampled
+  string hz_file = state_base + ".hz";
+  comment("- loading " + hz_file);
+  ifstream in(hz_file.c_str());
+  if(!in.is_open()) {
+    throw runtime_error(string("LDA::load_state(): cannot open ") + hz_file);
+  }
+  string line;
+  vector<string> strs;
+  int d = 0;
+  for(; getline(in, line); ++d) {
+    if(d >= num_docs) {
+      throw runtime_error(string("LDA::load_state(): more documents than the data in ") + hz_file);
+    }
+    split(line, ' ', strs);
+    int i = 0;
+    for(vector<string>::iterator s = strs.begin(); s != strs.end(); ++s) {
+      if(*s == "") continue;
+      int z = atoi(s->c_str());
+      if(i >= nd[d] || z < 0 || z >= num_topics) {
+        throw runtime_error("LDA::load_state(): unexpected topics of document " + str(d) + " in " + hz_file);
+      }
+      resample_post(d, (*docs)[d][i], z);
+      hz[d][i++] = z;
+    }
+    if(i != nd[d]) {
+      throw runtime_error("LDA::load_state(): unexpected topics of document " + str(d) + " in " + hz_file);
+    }
+  }
+  comment("# old docs: " + str(d));
+  return d;
+}
+
+void
+LDA::save_state(const string &hz_file) {
+  ofstream file(hz_file.c_str());
+  if(!file.is_open()) {
+    throw runtime_error(string("LDA::save_state(): cannot open ") + hz_file);
+  }
+  for(int d = 0; d < num_docs; d++) {
+    for(int i = 0; i < nd[d]; i++) {
+      file << hz[d][i] << " ";
+    }
+    file << "\n";
+  }
 }
 
 void
 LDA::infer() {
   comment("* Inference");
-  int step_every = max_steps / 10;
-  double old_pp = -1.0;
-  double converge_limit = 0.001;
-  for(int i = 0; i < max_steps; i++) {
+  int num_steps = max_steps; // and burn-in, reduced to fit the time budget if any
+  int burn = burn_in;
+  int step_every = num_steps / 10;
+  double old_ll = 0.0;
+  double converge_limit = 0.00001; // per token
+  double step_time = 0.0; // moving average of seconds per step
+  double save_time = 0.0; // seconds of the last save_params()
+  double pp_time = 0.0; // seconds of the last calc_perplexity()
+  double last_save = get_time();
+  int saved_step = -1; // of the last checkpoint
+  double pp = 0.0; // of the last evaluation
+
+  ofstream metrics;
+  if(metrics_file != "") {
+    metrics.open(metrics_file.c_str());
+    if(!metrics.is_open()) {
+      throw runtime_error(string("LDA::infer(): cannot open ") + metrics_file);
+    }
+  }
+  map<string, double> last_timings = timings;
+
+  for(int i = 0; i < num_steps; i++) {
+    double step_start = get_time();
     resample();
-    double pp = calc_perplexity();
+    double ll = get_log_likelihood();
+    bool report = (step_every == 0 || i % step_every == 0);
+    double start;
+    // a full pass unlike ll, on each step for metrics unless it costs the time budget
+    if(report || (metrics.is_open() && (time_budget <= 0.0 || pp_time < 0.1 * step_time))) {
+      start = get_time();
+      pp = calc_perplexity();
+      pp_time = get_time() - start;
+      timings["perplexity"] += pp_time;
+    }
     
-    if(step_every == 0 || i % step_every == 0) {
-      comment("- step " + str(i) + ": pp = " + str(pp));
-      if(verbose) {
+    if(report) {
+      comment("- step " + str(i) + ": pp = " + str(pp) + ", ll = " + str(ll));
+      if(verbose && (time_budget <= 0.0 || save_time < 0.1 * step_time)) { // snapshots only if cheap
+        start = get_time();
         save_params(out_base + ".step_" + str(i));
+        timings["save_params"] += get_time() - start;
       }
     }
 
-    if(i < burn_in) continue;
-
-    if(converge && fabs(pp - old_pp) < converge_limit) {
+    bool converged = false;
+    if(converge && i > burn && fabs(ll - old_ll) < converge_limit * num_terms) {
       comment("- converged"); // (heuristic) local optima of sampling
-      break;
+      converged = true;
     }
-    old_pp = pp;
-  
-    for(int j = 0; j < num_loops; j++) {
-      update_params();
+    finish_step(i, burn, !converged);
+    old_ll = get_log_likelihood();
+
+    if(metrics.is_open()) {
+      save_metrics(metrics, i, pp, last_timings);
+      last_timings = timings;
     }
+    if(converged) break;
+
+    if(time_budget > 0.0) {
+      // steps (and burn-in, evaluations) that fit before the deadline with the final save
+      double now = get_time();
+      step_time = (i == 0) ? now - step_start : 0.7 * step_time + 0.3 * (now - step_start);
+      if(out_base != "" && (i == 0 || now - last_save > max(10.0 * save_time, 0.1 * time_budget))) {
+        comment("- checkpoint at step " + str(i));
+        save_params(out_base + ".final"); // replaced later, in case of being killed
+        saved_step = i;
+        last_save = get_time();
+        save_time = last_save - now;
+        timings["save_params"] += save_time;
+        now = last_save;
+      }
+      double rest = start_time + time_budget - now - 1.5 * save_time;
+      int fit = i + 1 + static_cast<int>(max(0.0, rest) / (1.2 * step_time));
+      int steps = min(max_steps, fit);
+      if(steps != num_steps) {
+        num_steps = steps;
+        burn = min(burn_in, num_steps / 2); // leave steps for averaging and updates
+        step_every = num_steps / 10;
+        comment("- steps in the time budget: " + str(num_steps) + " (burn-in: " + str(burn) + ")");
+      }
+    }
+  }
+  // out_base is empty only if data is given by set_data(), and .final may be saved at the last step
+  if(out_base != "" && saved_step != num_steps - 1) {
+    double start = get_time();
+    save_params(out_base + ".final");
+    timings["save_params"] += get_time() - start;
   }
-  save_params(out_base + ".final");
   comment("* Finish");
 }
 
 void
 LDA::load_data(const string &file_name) {
+  int max_wid = 0;
+  shared_ptr<vector<vector<int> > > new_docs(new vector<vector<int> >());
+  nd.clear();
+  read_data(file_name, *new_docs, max_wid);
+  if(append_file != "") { // new documents after those of the state
+    comment("- loading " + append_file);
+    int num_data_docs = new_docs->size();
+    read_data(append_file, *new_docs, max_wid);
+    comment("# appended docs: " + str((int)new_docs->size() - num_data_docs));
+  }
+  num_words = max_wid + 1; // not assuming missing words
+  compact_words(*new_docs);
+  docs = new_docs;
+  num_docs = docs->size();
+  num_terms = sum(nd);
+}
+
+void
+LDA::read_data(const string &file_name, vector<vector<int> > &new_docs, int &max_wid) {
+  // appends documents of the file to new_docs (and nd)
   ifstream in(file_name.c_str());
   if(!in.is_open()) {
-    cerr << "LDA::load_data(): cannot open " << file_name << endl;
-    exit(1);
+    throw runtime_error(string("LDA::load_data(): cannot open ") + file_name);
   }
 
   string line;
   vector<int> doc;
   vector<string> wfs; // ("word:freq", "word2:freq2", ...)
-  vector<string> wf; // ("word", "freq")
-  int max_wid = 0;
-  docs.clear();
-  nd.clear();
   while(getline(in, line)) {
     split(line, ' ', wfs);
     doc.clear();
     for(vector<string>::iterator s = wfs.begin(); s != wfs.end(); ++s) {
       if(*s == "") continue;
-      split(*s, ':', wf);
-      assert(wf.size() == 2);
-      int wid = atoi(wf[0].c_str());
-      int freq = atoi(wf[1].c_str());
+      int wid, freq;
+      parse_word_freq(*s, wid, freq);
       for(int j = 0; j < freq; ++j) {
         doc.push_back(wid);
       }
@@ -164,50 +536,393 @@ LDA::load_data(const string &file_name) {
       }
     }
     nd.push_back(doc.size());
-    docs.push_back(doc);
+    new_docs.push_back(doc);
+  }
+}
+
+void
+LDA::set_data(int num_docs_, const int *indptr, const int *indices, const int *freqs) {
+  // CSR matrix of word freqs (cf. scipy.sparse.csr_matrix), instead of load_data()
+  vector<int> doc;
+  int max_wid = 0;
+  shared_ptr<vector<vector<int> > > new_docs(new vector<vector<int> >());
+  nd.clear();
+  for(int d = 0; d < num_docs_; ++d) {
+    doc.clear();
+    for(int j = indptr[d]; j < indptr[d+1]; ++j) {
+      int wid = indices[j];
+      for(int k = 0; k < freqs[j]; ++k) {
+        doc.push_back(wid);
+      }
+      if(max_wid < wid) {
+        max_wid = wid;
+      }
+    }
+    nd.push_back(doc.size());
+    new_docs->push_back(doc);
   }
-  num_docs = docs.size();
   num_words = max_wid + 1; // not assuming missing words
+  compact_words(*new_docs);
+  docs = new_docs;
+  num_docs = docs->size();
   num_terms = sum(nd);
 }
 
+void
+LDA::share_data(const LDA &other) {
+  // read-only docs shared with another instance (e.g. chains), instead of load_data()
+  data_file = "";
+  docs = other.docs;
+  nd = other.nd;
+  num_docs = other.num_docs;
+  num_words = other.num_words;
+  num_terms = other.num_terms;
+  word_ids = other.word_ids;
+  word_index = other.word_index;
+}
+
+void
+LDA::compact_words(vector<vector<int> > &new_docs) {
+  // remap word ids of the data to 0..(#present words - 1) in the same order if
+  // compact_word_ids, so that O(#words) loops and memory skip missing words
+  word_ids.clear();
+  word_index.clear();
+  if(!compact_word_ids) return;
+
+  word_index.assign(num_words, -1);
+  for(size_t d = 0; d < new_docs.size(); ++d) {
+    for(size_t i = 0; i < new_docs[d].size(); ++i) {
+      word_index[new_docs[d][i]] = 0;
+    }
+  }
+  for(int id = 0; id < num_words; ++id) {
+    if(word_index[id] < 0) continue;
+    word_index[id] = word_ids.size();
+    word_ids.push_back(id);
+  }
+  for(size_t d = 0; d < new_docs.size(); ++d) {
+    for(size_t i = 0; i < new_docs[d].size(); ++i) {
+      new_docs[d][i] = word_index[new_docs[d][i]];
+    }
+  }
+  num_words = word_ids.size();
+}
+
 void
 LDA::resample() { 
+  double start = get_time();
+  num_changes = 0;
+  if(num_old_docs > 0) {
+    old_begin = (old_begin + old_window) % num_old_docs;
+  }
+  if(num_threads > 1) {
+    resample_parallel();
+    timings["sample_topics"] += get_time() - start;
+    return;
+  }
+  if(word_major) {
+    for(int w = 0; w < num_words; ++w) {
+      const vector<pair<int, int> > &tokens = word_tokens[w];
+      for(size_t k = 0, l; k < tokens.size(); k = l) {
+        int d = tokens[k].first;
+        int i = tokens[k].second;
+        l = k + 1;
+        if(!is_swept(d)) continue;
+        if(grouped) {
+          for(; l < tokens.size() && tokens[l].first == d; ++l);
+          resample_group(d, i, i + (l - k));
+        } else {
+          resample_token(d, i);
+        }
+      }
+    }
+    timings["sample_topics"] += get_time() - start;
+    return;
+  }
   for(int d = 0; d < num_docs; d++) {
+    if(!is_swept(d)) continue;
+    if(grouped) {
+      // runs of the same word, as freqs are expanded in order by load_data()
+      for(int i = 0, j; i < nd[d]; i = j) {
+        for(j = i + 1; j < nd[d] && (*docs)[d][j] == (*docs)[d][i]; ++j);
+        resample_group(d, i, j);
+      }
+      continue;
+    }
     for(int i = 0; i < nd[d]; i++) {
-      int w = docs[d][i];
-      int z = hz[d][i];
+      resample_token(d, i);
+    }
+  }
+  timings["sample_topics"] += get_time() - start;
+}
 
-      resample_pre(d, w, z);
+void
+LDA::resample_parallel(bool init, int first_doc) {
+  // approximate distributed sampling (AD-LDA) of topics: threads sample tasks of token
+  // ranges against their own copies of the counts, which are merged after the step
+  // (if init, topics of documents from first_doc are initialized by init_topics() instead)
+  if(workers.empty()) init_workers();
 
-      calc_probs(d, w, probs);
-      z = multi(probs);
+  int num_tasks = tasks.size();
+  vector<long> weights(num_tasks, 0);
+  for(int k = 0; k < num_tasks; ++k) {
+    for(size_t j = 0; j < tasks[k].size(); ++j) {
+      int d = tasks[k][j].d;
+      if(init ? d >= first_doc : is_swept(d)) weights[k] += tasks[k][j].end - tasks[k][j].begin;
+    }
+  }
+  vector<unsigned> seeds(num_threads);
+  for(int t = 0; t < num_threads; ++t) {
+    seeds[t] = draw_seed();
+  }
+  vector<vector<int> > deltas(num_tasks); // deltas[k] = changes of cdz in k-th task if a document is split
+  vector<int> changes(num_threads, 0);
+  TaskScheduler scheduler(weights, num_threads);
+  scheduler.run([&](int t, int k) { changes[t] += run_task(*workers[t], k, deltas[k], init, first_doc); },
+                [&](int t) { set_seed(seeds[t]); workers[t]->copy_counts(*this); });
+  utilization = scheduler.get_utilization();
 
-      resample_post(d, w, z);
-      hz[d][i] = z;
+  // chunks of a split document read its cdz before the step, so their changes are added here
+  for(int k = 0; k < num_tasks; ++k) {
+    if(deltas[k].empty()) continue;
+    int d = tasks[k][0].d;
+    for(int z = 0; z < num_topics; ++z) {
+      cdz.set(d, z, cdz.get(d, z) + deltas[k][z]);
     }
   }
+  merge_counts(workers);
+  if(compact_counts) { // promotion of rows is not thread-safe
+    merge_word_counts(workers, 0, num_words);
+  } else {
+    vector<long> ones(num_threads, 1);
+    TaskScheduler merger(ones, num_threads);
+    merger.run([&](int, int k) {
+        merge_word_counts(workers, (long)num_words * k / num_threads, (long)num_words * (k + 1) / num_threads);
+      });
+  }
+  for(int t = 0; t < num_threads; ++t) {
+    num_changes += changes[t];
+    log_lik += workers[t]->get_log_likelihood(); // approximate, with stale counts
+  }
+}
+
+int
+LDA::run_task(LDA &worker, int k, vector<int> &deltas, bool init, int first_doc) {
+  // the worker samples token ranges of the task as its documents, starting from
+  // the counts of the whole documents
+  vector<TokenRange> ranges;
+  for(size_t j = 0; j < tasks[k].size(); ++j) {
+    int d = tasks[k][j].d;
+    if(init ? d >= first_doc : is_swept(d)) ranges.push_back(tasks[k][j]);
+  }
+  int n = ranges.size();
+  if(n == 0) return 0;
+  shared_ptr<vector<vector<int> > > task_docs(new vector<vector<int> >(n));
+  worker.hz.resize(n);
+  worker.nd.resize(n);
+  worker.cdz.assign(n, num_topics);
+  for(int j = 0; j < n; ++j) {
+    const TokenRange &r = ranges[j];
+    const vector<int> &doc = (*docs)[r.d];
+    (*task_docs)[j].assign(doc.begin() + r.begin, doc.begin() + r.end);
+    worker.hz[j].assign(hz[r.d].begin() + r.begin, hz[r.d].begin() + r.end);
+    worker.nd[j] = r.end - r.begin;
+    for(int z = 0; z < num_topics; ++z) {
+      worker.cdz.set(j, z, cdz.get(r.d, z));
+    }
+  }
+  worker.docs = task_docs;
+  worker.num_docs = n;
+  worker.begin_task();
+  if(init) {
+    worker.init_topics(0, n);
+  } else {
+    worker.LDA::resample(); // only topics (e.g. not dtrees of LDADF)
+  }
+
+  for(int j = 0; j < n; ++j) {
+    const TokenRange &r = ranges[j];
+    copy(worker.hz[j].begin(), worker.hz[j].end(), hz[r.d].begin() + r.begin);
+    if(r.begin == 0 && r.end == nd[r.d]) { // only this thread has the document
+      for(int z = 0; z < num_topics; ++z) {
+        cdz.set(r.d, z, worker.cdz.get(j, z));
+      }
+    } else {
+      assert(n == 1);
+      deltas.assign(num_topics, 0);
+      for(int z = 0; z < num_topics; ++z) {
+        deltas[z] = worker.cdz.get(j, z) - cdz.get(r.d, z);
+      }
+    }
+  }
+  return init ? 0 : worker.num_changes;
+}
+
+void
+LDA::build_tasks() {
+  // documents longer than a chunk are split into tasks of chunks, and shorter ones
+  // are packed into tasks of up to a chunk, which is small enough to balance threads
+  long chunk = min<long>(chunk_size, max<long>(1, num_terms / (num_threads * 8)));
+  if(compact_counts) {
+    chunk = min<long>(chunk, 65535); // a whole document in a task has no overflow of cdz
+  }
+  tasks.clear();
+  vector<TokenRange> task;
+  long size = 0;
+  for(int d = 0; d < num_docs; ++d) {
+    if(nd[d] > chunk) {
+      for(int i = 0; i < nd[d]; i += chunk) {
+        TokenRange r = {d, i, (int)min<long>(i + chunk, nd[d])};
+        tasks.push_back(vector<TokenRange>(1, r));
+      }
+      continue;
+    }
+    if(size + nd[d] > chunk && !task.empty()) {
+      tasks.push_back(task);
+      task.clear();
+      size = 0;
+    }
+    TokenRange r = {d, 0, nd[d]};
+    task.push_back(r);
+    size += nd[d];
+  }
+  if(!task.empty()) {
+    tasks.push_back(task);
+  }
+}
+
+void
+LDA::init_workers() {
+  // copies without per-document state, which they take from each task instead
+  build_tasks();
+  vector<vector<int> > hz_, nd_;
+  CountMatrix cdz_;
+  vector<vector<double> > phi_, theta_, phi_sum_, theta_sum_;
+  vector<vector<pair<int, int> > > word_tokens_;
+  vector<vector<TokenRange> > tasks_;
+  swap(hz, hz_);
+  swap(cdz, cdz_);
+  swap(phi, phi_);
+  swap(theta, theta_);
+  swap(phi_sum, phi_sum_);
+  swap(theta_sum, theta_sum_);
+  swap(word_tokens, word_tokens_);
+  swap(tasks, tasks_);
+  workers.clear();
+  for(int t = 0; t < num_threads; ++t) {
+    LDA *worker = clone();
+    worker->num_threads = 1;
+    worker->word_major = false;
+    worker->num_old_docs = 0; // tasks already have only the swept documents
+    workers.push_back(shared_ptr<LDA>(worker));
+  }
+  swap(hz, hz_);
+  swap(cdz, cdz_);
+  swap(phi, phi_);
+  swap(theta, theta_);
+  swap(phi_sum, phi_sum_);
+  swap(theta_sum, theta_sum_);
+  swap(word_tokens, word_tokens_);
+  swap(tasks, tasks_);
+}
+
+void
+LDA::copy_counts(const LDA &other) {
+  // counts shared by documents, at the start of a parallel step
+  cz = other.cz;
+  cwz = other.cwz;
+  alphas = other.alphas;
+  betas = other.betas;
+  log_lik = 0.0;
+  lik_ratio = 1.0;
+}
+
+void
+LDA::merge_counts(const vector<shared_ptr<LDA> > &workers) {
+  // add changes of the workers, which started from these counts
+  for(int z = 0; z < num_topics; ++z) {
+    int c = cz[z];
+    for(size_t t = 0; t < workers.size(); ++t) {
+      cz[z] += workers[t]->cz[z] - c;
+    }
+  }
+}
+
+void
+LDA::merge_word_counts(const vector<shared_ptr<LDA> > &workers, int begin, int end) {
+  // merge_counts() for cwz of words in [begin, end)
+  for(int w = begin; w < end; ++w) {
+    for(int z = 0; z < num_topics; ++z) {
+      int c = cwz.get(w, z);
+      int s = c;
+      for(size_t t = 0; t < workers.size(); ++t) {
+        s += workers[t]->cwz.get(w, z) - c;
+      }
+      if(s != c) cwz.set(w, z, s);
+    }
+  }
+}
+
+void
+LDA::resample_token(int d, int i) {
+  int w = (*docs)[d][i];
+  int z = hz[d][i];
+
+  resample_pre(d, w, z);
+  int new_z = sample_topic(d, w);
+  // ratio of joint likelihoods = ratio of the conditionals of new_z and z
+  track_log_likelihood((cdz.get(d, new_z) + alphas[new_z]) * calc_prob_weight(w, new_z)
+                       / ((cdz.get(d, z) + alphas[z]) * calc_prob_weight(w, z)));
+  if(new_z != z) ++num_changes;
+  resample_post(d, w, new_z);
+  hz[d][i] = new_z;
 }
 
 void
 LDA::resample_pre(int d, int w, int z) {
-  --cdz[d][z];
-  --cwz[w][z];
+  cdz.dec(d, z);
+  cwz.dec(w, z);
   --cz[z];
 }
 
 void
 LDA::resample_post(int d, int w, int z) {
-  ++cdz[d][z];
-  ++cwz[w][z];
+  cdz.inc(d, z);
+  cwz.inc(w, z);
   ++cz[z];
 }
 
+void
+LDA::resample_group(int d, int begin, int end) {
+  // all tokens in [begin, end) of the same word are removed first, then sampled
+  // from the conditional computed once, instead of one conditional per token
+  int w = (*docs)[d][begin];
+  for(int i = begin; i < end; ++i) {
+    int z = hz[d][i];
+    resample_pre(d, w, z);
+    track_log_likelihood(1.0 / ((cdz.get(d, z) + alphas[z]) * calc_prob_weight(w, z)));
+  }
+  calc_weights(d, w, probs);
+  for(int i = begin; i < end; ++i) {
+    int new_z = multi_cum(&probs[0], num_topics);
+    track_log_likelihood((cdz.get(d, new_z) + alphas[new_z]) * calc_prob_weight(w, new_z));
+    resample_post(d, w, new_z);
+    if(new_z != hz[d][i]) ++num_changes;
+    hz[d][i] = new_z;
+  }
+}
+
+int
+LDA::sample_topic(int d, int w) {
+  calc_weights(d, w, probs);
+  return multi_cum(&probs[0], num_topics);
+}
+
 void
 LDA::calc_probs(int d, int w, vector<double> &probs) {
   assert(probs.size() == num_topics);
   for(int j = 0; j < num_topics; ++j) {
-    probs[j] = (cwz[w][j] + betas[w]) * (cdz[d][j] + alphas[j]);
+    probs[j] = (cwz.get(w, j) + betas[w]) * (cdz.get(d, j) + alphas[j]);
     double denom = cz[j] + beta * num_words;
     if(denom > 0) probs[j] /= denom;
     else cerr << "warning in LDA::calc_probs(): denom is zero" << endl;
@@ -215,6 +930,42 @@ LDA::calc_probs(int d, int w, vector<double> &probs) {
   norm(probs);
 }
 
+double
+LDA::calc_prob_weight(int w, int z) {
+  // predictive probability of word w in topic z
+  return (cwz.get(w, z) + betas[w]) / (cz[z] + beta * num_words);
+}
+
+double
+LDA::calc_weights(int d, int w, vector<double> &cum) {
+  // unnormalized version of calc_probs() accumulated for multi_cum()
+  assert((int)cum.size() == num_topics);
+  const int *cw = cwz.row(w, &count_rows[0]);
+  const int *cd = cdz.row(d, &count_rows[num_topics]);
+  return cum_prod_ratio(cw, betas[w], cd, &alphas[0], &cz[0], beta * num_words,
+                        num_topics, &cum[0]);
+}
+
+void
+LDA::finish_step(int step, int burn, bool update) {
+  // hyperparameters (if update) and averages of parameters after burn-in
+  if(step < burn) return;
+  double start;
+  if(update) {
+    start = get_time();
+    for(int j = 0; j < num_loops; j++) {
+      update_params();
+    }
+    if(num_loops > 0) sync_log_likelihood(); // alphas are changed
+    timings["update_params"] += get_time() - start;
+  }
+  if(average_every > 0 && (step - burn) % average_every == 0) {
+    start = get_time();
+    accumulate_params();
+    timings["accumulate_params"] += get_time() - start;
+  }
+}
+
 void
 LDA::update_params() {
   // hyperparameter update by Minka's fixed point iteration
@@ -225,7 +976,7 @@ LDA::update_params() {
     double num = 0;
     double denom = 0;
     for(int d = 0; d < num_docs; d++) {
-      num += digamma(cdz[d][z]+alphas[z]) - digamma(alphas[z]);
+      num += digamma(cdz.get(d, z)+alphas[z]) - digamma(alphas[z]);
       denom += digamma(nd[d]+sum_alpha) - digamma(sum_alpha);
     }
     if(num <= 0 || denom <= 0) {
@@ -240,6 +991,24 @@ LDA::update_params() {
   }
 }
 
+void
+LDA::accumulate_params() {
+  // running sums of phi and theta for their posterior mean, without keeping samples
+  get_phi(phi);
+  for(int z = 0; z < num_topics; z++) {
+    for(int w = 0; w < num_words; w++) {
+      phi_sum[z][w] += phi[z][w];
+    }
+  }
+  get_theta(theta);
+  for(int d = 0; d < num_docs; d++) {
+    for(int z = 0; z < num_topics; z++) {
+      theta_sum[d][z] += theta[d][z];
+    }
+  }
+  ++num_samples;
+}
+
 double
 LDA::calc_perplexity() {
   get_theta(theta);
@@ -248,7 +1017,7 @@ LDA::calc_perplexity() {
   double lik = 0.0;
   for(int d = 0; d < num_docs; d++) {
     for(int i = 0; i < nd[d]; i++) {
-      int w = docs[d][i];
+      int w = (*docs)[d][i];
       double prob = 0.0;
       for(int z = 0; z < num_topics; z++) {
         prob += theta[d][z]*phi[z][w];
@@ -260,41 +1029,163 @@ LDA::calc_perplexity() {
   return exp(-lik/num_terms);
 }
 
+double
+LDA::calc_log_likelihood() {
+  // log p(w, z) with theta and phi integrated out, in O(#docs * #topics + #topics * #words)
+  double sum_alpha = sum(alphas);
+  double lik = 0.0;
+  for(int d = 0; d < num_docs; d++) {
+    lik += lgamma(sum_alpha) - lgamma(nd[d] + sum_alpha);
+    for(int z = 0; z < num_topics; z++) {
+      lik += lgamma(cdz.get(d, z) + alphas[z]) - lgamma(alphas[z]);
+    }
+  }
+  for(int z = 0; z < num_topics; z++) {
+    lik += calc_topic_log_likelihood(z);
+  }
+  return lik;
+}
+
+double
+LDA::calc_topic_log_likelihood(int z) {
+  // log p(words assigned to z | z)
+  double lik = lgamma(beta * num_words) - lgamma(cz[z] + beta * num_words);
+  for(int w = 0; w < num_words; w++) {
+    lik += lgamma(cwz.get(w, z) + betas[w]) - lgamma(betas[w]);
+  }
+  return lik;
+}
+
+void
+LDA::sync_log_likelihood() {
+  // recompute by a full pass, e.g. after hyperparameters are changed
+  log_lik = calc_log_likelihood();
+  lik_ratio = 1.0;
+}
+
 void
 LDA::save_params(const string &out_base) {
   comment("wrote to " + out_base + ".*");
 
-  string theta_file = out_base + ".theta";
+  // posterior mean if samples are accumulated, otherwise the current sample
   get_theta(theta);
+  get_mean_phi(phi);
+  if(num_samples > 0) {
+    for(int d = 0; d < num_docs; d++) {
+      for(int z = 0; z < num_topics; z++) {
+        theta[d][z] = theta_sum[d][z] / num_samples;
+      }
+    }
+  }
+  if(save_hz) {
+    save_state(out_base + ".hz");
+  }
+  if(sparse_top_k > 0 || sparse_threshold > 0.0) {
+    save_sparse_params(out_base);
+    return;
+  }
+
+  string theta_file = out_base + ".theta";
   save_matrix(theta_file, theta);
 
-  string phi_file = out_base + ".phi";;
-  get_phi(phi);
-  save_matrix_t(phi_file, phi);
+  string phi_file = out_base + ".phi";
+  if(!word_ids.empty()) { // back to word ids of the data, where missing words have zeros
+    vector<vector<double> > id_phi(num_topics, vector<double>(word_index.size(), 0.0));
+    for(int z = 0; z < num_topics; z++) {
+      for(int w = 0; w < num_words; w++) {
+        id_phi[z][word_ids[w]] = phi[z][w];
+      }
+    }
+    save_matrix_t(phi_file, id_phi);
+  } else {
+    save_matrix_t(phi_file, phi);
+  }
+
+  string smp_file = out_base + ".smp";
+  vector<vector<int> > smp;
+  cwz.to_vector(smp);
+  if(!word_ids.empty()) {
+    vector<vector<int> > id_smp(word_index.size(), vector<int>(num_topics, 0));
+    for(int w = 0; w < num_words; w++) {
+      id_smp[word_ids[w]].swap(smp[w]);
+    }
+    smp.swap(id_smp);
+  }
+  save_matrix_t(smp_file, smp);
+}
+
+void
+LDA::save_sparse_params(const string &out_base) {
+  // "index:value" of each document (.theta) or topic (.phi, .smp) by rows of theta/phi and
+  // columns of cwz, without transposed copies; .smp keeps all non-zero counts
+  save_sparse_matrix(out_base + ".theta", theta, sparse_top_k, sparse_threshold);
+  save_sparse_matrix(out_base + ".phi", phi, sparse_top_k, sparse_threshold, word_ids);
 
   string smp_file = out_base + ".smp";
-  save_matrix_t(smp_file, cwz);
+  ofstream file(smp_file.c_str());
+  if(!file.is_open()) {
+    throw runtime_error(string("LDA::save_sparse_params(): cannot open ") + smp_file);
+  }
+  vector<int> counts(num_words);
+  for(int z = 0; z < num_topics; z++) {
+    for(int w = 0; w < num_words; w++) {
+      counts[w] = cwz.get(w, z);
+    }
+    write_sparse_row(file, counts, 0, 1.0, word_ids);
+  }
+}
+
+void
+LDA::save_metrics(ofstream &file, int step, double pp, const map<string, double> &last_timings) {
+  // one json line per step, where times are elapsed seconds in the step
+  double sample_time = 0.0;
+  file << "{\"step\": " << step << ", \"pp\": " << pp << ", \"time\": {";
+  for(map<string, double>::const_iterator i = timings.begin(); i != timings.end(); ++i) {
+    double t = i->second;
+    map<string, double>::const_iterator j = last_timings.find(i->first);
+    if(j != last_timings.end()) t -= j->second;
+    if(i->first == "sample_topics" || i->first == "sample_dtrees") sample_time += t;
+    if(i != timings.begin()) file << ", ";
+    file << "\"" << i->first << "\": " << t;
+  }
+  file << "}, \"tokens_per_sec\": " << (sample_time > 0 ? num_terms / sample_time : 0.0);
+  file << ", \"change_rate\": " << static_cast<double>(num_changes) / num_terms;
+  file << ", \"ll\": " << get_log_likelihood();
+  file << ", \"peak_rss_kb\": " << get_peak_rss() << "}" << endl;
 }
 
 void
 LDA::get_phi(vector<vector<double> > &phi) {
-  assert(phi.size() == num_topics);
-  assert(phi[0].size() == num_words);
+  assert((int)phi.size() == num_topics);
+  assert((int)phi[0].size() == num_words);
   for(int z = 0; z < num_topics; z++) {
     for(int w = 0; w < num_words; w++) {
-      phi[z][w] = cwz[w][z] + betas[w];
+      phi[z][w] = cwz.get(w, z) + betas[w];
     }
     norm(phi[z]);
   }
 }
 
+void
+LDA::get_mean_phi(vector<vector<double> > &phi) {
+  // posterior mean if samples are accumulated, otherwise the current sample
+  get_phi(phi);
+  if(num_samples > 0) {
+    for(int z = 0; z < num_topics; z++) {
+      for(int w = 0; w < num_words; w++) {
+        phi[z][w] = phi_sum[z][w] / num_samples;
+      }
+    }
+  }
+}
+
 void
 LDA::get_theta(vector<vector<double> > &theta) {
-  assert(theta.size() == num_docs);
-  assert(theta[0].size() == num_topics);
+  assert((int)theta.size() == num_docs);
+  assert((int)theta[0].size() == num_topics);
   for(int d = 0; d < num_docs; d++) {
     for(int z = 0; z < num_topics; z++) {
-      theta[d][z] = cdz[d][z] + alphas[z];
+      theta[d][z] = cdz.get(d, z) + alphas[z];
     }
     norm(theta[d]);
   }
@@ -305,14 +1196,14 @@ LDA::print_debug() {
   cout << "cdz:" << endl;
   for(int d = 0; d < num_docs; ++d) {
     for(int z = 0; z < num_topics; ++z) {
-      cout << cdz[d][z] << " ";
+      cout << cdz.get(d, z) << " ";
     }
     cout << endl;
   }
   cout << "cwz:" << endl;
   for(int w = 0; w < num_words; ++w) {
     for(int z = 0; z < num_topics; ++z) {
-      cout << cwz[w][z] << " ";
+      cout << cwz.get(w, z) << " ";
     }
     cout << endl;
   }
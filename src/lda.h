@@ -1,16 +1,54 @@
 #ifndef LDA_H
 #define LDA_H
 
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "counts.h"
+
+struct TokenRange {
+  int d; // document
+  int begin; // first token
+  int end; // last token + 1
+};
+
 class LDA {
   friend class TestLDA;
+  friend class LDABench;
+  friend class LDABinding;
+  friend class LDAChains;
+  friend class TestLDAChains;
+  friend class LDAGrid;
+  friend class TestLDAGrid;
+  friend class LDAHeldout;
+  friend class TestLDAHeldout;
 
  public:
   LDA() {};
   LDA(std::string data_file, std::string out_base = "", int num_topics = 10, double alpha = 0.1, double beta = 0.1,
       int max_steps = 100, int num_loops = 0, int burn_in = 5, bool converge = false, int rand_seed = 0, bool verbose = false);
+  virtual ~LDA() {};
+
+  virtual void set_metrics_file(const std::string &file);
+  virtual void set_data(int num_docs, const int *indptr, const int *indices, const int *freqs);
+  virtual void share_data(const LDA &other);
+  virtual void set_grouped(bool grouped);
+  virtual void set_word_major(bool word_major);
+  virtual void set_average_every(int every);
+  virtual void set_compact_counts(bool compact);
+  virtual void set_compact_words(bool compact);
+  virtual void set_threads(int num_threads, int chunk_size = 10000);
+  virtual void set_sparse_output(int top_k, double threshold = 0.0);
+  virtual void set_warm_start(const std::string &prior_base);
+  virtual void set_resume(const std::string &state_base, const std::string &append_file = "", double old_rate = 1.0);
+  virtual void set_save_state(bool save);
+  virtual void set_conditional_init(bool conditional);
+  virtual void set_time_budget(double seconds);
 
   virtual void run();
   virtual void initialize();
@@ -19,19 +57,63 @@ class LDA {
 
  protected:
   virtual void load_data(const std::string &file_name);
+  void read_data(const std::string &file_name, std::vector<std::vector<int> > &new_docs, int &max_wid);
+  int load_state(const std::string &state_base);
+  void save_state(const std::string &hz_file);
+  void init_conditional(int first_doc);
+  void init_topics(int begin, int end);
+  void load_prior(const std::string &prior_base, std::vector<std::vector<double> > &prior_cwz, std::vector<double> &prior_cz);
+  void compact_words(std::vector<std::vector<int> > &new_docs);
 
   virtual void resample();
+  void resample_parallel(bool init = false, int first_doc = 0);
+  // all new documents and a rotating window of old ones are swept if resumed with old_rate < 1
+  bool is_swept(int d) const {
+    return d >= num_old_docs || (d - old_begin + num_old_docs) % num_old_docs < old_window;
+  }
+  virtual void resample_token(int d, int i);
+  virtual void resample_group(int d, int begin, int end);
   virtual void resample_pre(int d, int w, int z);
   virtual void resample_post(int d, int w, int z);
+  virtual int sample_topic(int d, int w);
   virtual void calc_probs(int d, int w, std::vector<double> &probs);
+  virtual double calc_weights(int d, int w, std::vector<double> &cum);
   virtual void update_params();
+  virtual void accumulate_params();
+  void finish_step(int step, int burn, bool update); // after resample() in infer() (and chains)
+  virtual double calc_prob_weight(int w, int z);
 
   virtual double calc_perplexity();
+  virtual double calc_log_likelihood();
+  virtual double calc_topic_log_likelihood(int z);
+  double get_log_likelihood() const { return log_lik + log(lik_ratio); }
+  void sync_log_likelihood();
+  // multiply the likelihood by ratio, folding into log_lik before the product over/underflows
+  void track_log_likelihood(double ratio) {
+    lik_ratio *= ratio;
+    if(lik_ratio > 1e100 || lik_ratio < 1e-100) {
+      log_lik += log(lik_ratio);
+      lik_ratio = 1.0;
+    }
+  }
   virtual void save_params(const std::string &out_base);
+  void save_sparse_params(const std::string &out_base);
+  virtual void save_metrics(std::ofstream &file, int step, double pp, const std::map<std::string, double> &last_timings);
   virtual void get_phi(std::vector<std::vector<double> > &phi);
+  void get_mean_phi(std::vector<std::vector<double> > &phi);
   virtual void get_theta(std::vector<std::vector<double> > &theta);
 
   virtual void print_debug();
+
+  // parallel sampling
+  virtual LDA *clone() const { return new LDA(*this); }
+  virtual void copy_counts(const LDA &other);
+  virtual void merge_counts(const std::vector<std::shared_ptr<LDA> > &workers);
+  void merge_word_counts(const std::vector<std::shared_ptr<LDA> > &workers, int begin, int end);
+  void build_tasks();
+  void init_workers();
+  int run_task(LDA &worker, int k, std::vector<int> &deltas, bool init, int first_doc);
+  virtual void begin_task() {} // after run_task() installs the counts of a task in the worker
   
  protected:
   // arguments
@@ -46,12 +128,33 @@ class LDA {
   double beta;
   bool converge;
   bool verbose;
+  bool grouped; // sample tokens of the same word in a document from one shared conditional
+  bool word_major; // sweep tokens word by word instead of document by document
+  int average_every; // accumulate phi and theta every k steps after burn-in (disabled if 0)
+  bool compact_counts; // store counts as uint16_t, promoting rows on overflow
+  bool compact_word_ids; // remap word ids to those present in the data
+  int sparse_top_k; // write only top-k entries of each topic/document (disabled if 0)
+  double sparse_threshold; // write only entries >= threshold of each topic/document (disabled if 0)
+  std::string warm_start_base; // prefix of .smp (and .dti) of a prior model to initialize topics (disabled if empty)
+  std::string resume_base; // prefix of .hz (and .dti) of a saved state of leading documents (disabled if empty)
+  std::string append_file; // data appended to the documents of data_file (disabled if empty)
+  double old_rate; // rate of old documents (in the state) swept in each step
+  bool save_hz; // save topics of tokens (.hz) as a state to be resumed
+  bool conditional_init; // initialize topics by the conditional of the counts so far instead of uniformly
+  double time_budget; // seconds from initialize() to the final save of infer() (disabled if 0)
+  double start_time; // of initialize()
+  int num_old_docs; // documents in the resumed state, which are followed by new ones
+  int old_begin; // first old document swept in this step
+  int old_window; // number of old documents swept in each step
 
   // docs
-  std::vector<std::vector<int> > docs;
+  std::shared_ptr<const std::vector<std::vector<int> > > docs; // docs[d][i] = word of i-th term in document d
   int num_docs;
   int num_words;
   int num_terms;
+  std::vector<int> word_ids; // word_ids[w] = word id in the data of word w (only if remapped)
+  std::vector<int> word_index; // word_index[id] = word of word id in the data, or -1 if missing (only if remapped)
+  std::vector<std::vector<std::pair<int, int> > > word_tokens; // word_tokens[w] = (d, i) of tokens of word w (only in word-major)
 
   // hyper-parameters (can be updated)
   std::vector<double> alphas;
@@ -61,13 +164,35 @@ class LDA {
   std::vector<int> nd; // nd[d] = number of terms in document d
   std::vector<std::vector<int> > hz; // hz[d][i] = topic assigned for i-th term in document d
   std::vector<int> cz; // cz[z] = count of topic z
-  std::vector<std::vector<int> > cdz; // cdz[d][z] = count of topic z for document d
-  std::vector<std::vector<int> > cwz; // cwz[w][z] = count of topic z for word w
+  CountMatrix cdz; // cdz.get(d, z) = count of topic z for document d
+  CountMatrix cwz; // cwz.get(w, z) = count of topic z for word w
 
   // tenporary memory
   std::vector<double> probs;
+  std::vector<int> count_rows; // rows of cwz and cdz widened to int
   std::vector<std::vector<double> > phi;
   std::vector<std::vector<double> > theta;
+
+  // posterior mean
+  int num_samples; // number of accumulated samples
+  std::vector<std::vector<double> > phi_sum; // phi_sum[z][w] = sum of phi over samples
+  std::vector<std::vector<double> > theta_sum; // theta_sum[d][z] = sum of theta over samples
+
+  // joint log-likelihood log p(w, z), tracked by each topic change instead of a full pass
+  double log_lik; // folded part
+  double lik_ratio; // product of likelihood ratios since the last fold
+
+  // parallel sampling
+  int num_threads;
+  int chunk_size; // max tokens in a task, where longer documents are split
+  std::vector<std::vector<TokenRange> > tasks; // tasks[k] = token ranges sampled in k-th task
+  std::vector<std::shared_ptr<LDA> > workers; // workers[t] = copy of counts in thread t
+  double utilization; // of threads in the last parallel step
+
+  // profiling
+  std::string metrics_file; // json lines of metrics for each step (disabled if empty)
+  std::map<std::string, double> timings; // timings[phase] = elapsed seconds in total
+  int num_changes; // number of topic changes in the last step
 };
 
 #endif
@@ -1,12 +1,16 @@
 #include "ldadf.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
 
 #include <iostream>
+#include <stdexcept>
 #include <fstream>
+#include <map>
 #include <numeric>
+#include <set>
 using namespace std;
 
 #include "utils.h"
@@ -28,30 +32,77 @@ void
 LDADF::initialize() {
   LDA::initialize();
 
-  comment("- loading " + dnf_file);
-
-  load_dnf(dnf_file);
-  comment("# dtrees: " + str(num_dtrees));
-
-  ctz.assign(num_dtrees, vector<int>(num_topics, 0));
-  for(int t = 0; t < num_dtrees; ++t) {
-    ctze.push_back(vector<vector<int> >(num_topics, vector<int>(dtrees[t].eps.size(), 0)));
+  if(dnf_file != "") { // otherwise given by set_dnf()
+    comment("- loading " + dnf_file);
+    double start = get_time();
+    load_dnf(dnf_file);
+    timings["load_dnf"] += get_time() - start;
   }
+  if(!word_ids.empty() && dtrees == parsed_dtrees) { // word ids of the dnf to compacted ones, unless shared
+    shared_ptr<vector<DTree> > compacted(new vector<DTree>(*parsed_dtrees));
+    for(int t = 0; t < num_dtrees; ++t) {
+      (*compacted)[t].remap(word_index);
+    }
+    dtrees = compacted;
+  }
+  comment("# dtrees: " + str(num_dtrees));
+  index_dtrees();
+  comment("# distinct eps: " + str((int)cez.size()));
+  comment("# distinct nps: " + str((int)cnz.size()));
 
   dz.assign(num_topics, 0);
   dtree_probs.assign(num_dtrees, 0.0);
+  dtree_weights.assign(num_dtrees, 0.0);
+  ep_word_weights.assign(num_words, 0.0);
+  // where buckets get faster than the dense conditional, if tokens are swept by documents
+  // (a word-major sweep changes the document at each token, recomputing its bucket in O(K))
+  bucketed = num_topics > 48 && !word_major;
+  bucket_topics.assign(num_topics, 0);
+  bucket_cum.assign(num_topics, 0.0);
+  constrained_topics.assign(num_topics, 0);
+
+  coded_dz.assign(num_topics, -1);
+  word_topics.assign(num_words, vector<pair<int, int> >());
+  root_denoms.assign(num_topics, 0.0);
+  nonp_denoms.assign(num_topics, 0.0);
+  nonp_nums.assign(num_topics, 0.0);
+  none_coefs.assign(num_topics, 0.0);
+  refresh_coefs();
+  index_word_topics();
 }
 
 void
 LDADF::preprocess() {
+  // trees of the resumed state or the prior model if given
+  string base = resume_base != "" ? resume_base : warm_start_base;
+  string dti_file = base + ".dti";
+  if(base != "" && ifstream(dti_file.c_str()).is_open()) {
+    comment("- loading " + dti_file);
+    vector<vector<double> > dti;
+    load_matrix(dti_file, dti);
+    if(dti.empty() || (int)dti[0].size() != num_topics) {
+      throw runtime_error("LDADF::preprocess(): " + dti_file + " does not have " + str(num_topics) + " topics");
+    }
+    for(int z = 0; z < num_topics; ++z) {
+      dz[z] = static_cast<int>(dti[0][z]);
+      if(dz[z] < 0 || dz[z] >= num_dtrees) {
+        throw runtime_error("LDADF::preprocess(): unknown dtree " + str(dz[z]) + " in " + dti_file);
+      }
+    }
+    refresh_coefs();
+    LDA::preprocess();
+    return;
+  }
+
   // tree sampling
   for(int t = 0; t < num_dtrees; t++) {
-    dtree_probs[t] = num_words - dtrees[t].np.size();
+    dtree_probs[t] = num_words - (*dtrees)[t].np.size();
   }
   norm(dtree_probs);
   for(int z = 0; z < num_topics; ++z) {
     dz[z] = multi(dtree_probs);
   }
+  refresh_coefs();
 
   // topic sampling
   LDA::preprocess();
@@ -60,10 +111,17 @@ LDADF::preprocess() {
 void
 LDADF::resample() {
   // tree sampling
+  double start = get_time();
   for(int z = 0; z < num_topics; ++z) {
     calc_dtree_probs(z, dtree_probs);
-    dz[z] = multi(dtree_probs);
+    int t = multi(dtree_probs);
+    if(t != dz[z]) {
+      log_lik += dtree_weights[t] - dtree_weights[dz[z]];
+      dz[z] = t;
+    }
   }
+  refresh_coefs(); // also after hyperparameters are updated
+  timings["sample_dtrees"] += get_time() - start;
 
   // topic sampling
   LDA::resample();
@@ -71,53 +129,159 @@ LDADF::resample() {
 
 void
 LDADF::resample_pre(int d, int w, int z) {
+  if(d == bucket_doc) { // topic z out of the sums, and back with its updated coefficients
+    smooth_mass -= alphas[z] * beta * none_coefs[z];
+    doc_mass -= cdz.get(d, z) * beta * none_coefs[z];
+  } else {
+    bucket_doc = -1;
+  }
   LDA::resample_pre(d, w, z);
+  if(bucketed && cwz.get(w, z) == 0) {
+    vector<int> &topics = nonzero_topics[w];
+    *find(topics.begin(), topics.end(), z) = topics.back();
+    topics.pop_back();
+  }
 
-  for(int t = 0; t < num_dtrees; ++t) {
-    DTree &dt = dtrees[t];
-    int e;
-    switch(dt.get_type(w)) {
-    case DTree::Ep:
-      e = dt.get_ep(w);
-      --ctz[t][z];
-      --ctze[t][z][e];
-      break;
-    case DTree::None:
-      --ctz[t][z];
-      break;
-    }
+  const vector<int> &eps = word_eps[w];
+  for(size_t i = 0; i < eps.size(); ++i) {
+    cez.dec(eps[i], z);
+  }
+  const vector<int> &nps = word_nps[w];
+  for(size_t i = 0; i < nps.size(); ++i) {
+    cnz.dec(nps[i], z);
+  }
+  update_coefs(z);
+  if(d == bucket_doc) {
+    smooth_mass += alphas[z] * beta * none_coefs[z];
+    doc_mass += cdz.get(d, z) * beta * none_coefs[z];
   }
 }
 
 void
 LDADF::resample_post(int d, int w, int z) {
+  if(d == bucket_doc) {
+    smooth_mass -= alphas[z] * beta * none_coefs[z];
+    doc_mass -= cdz.get(d, z) * beta * none_coefs[z];
+  } else {
+    bucket_doc = -1;
+  }
   LDA::resample_post(d, w, z);
+  if(bucketed && cwz.get(w, z) == 1) {
+    nonzero_topics[w].push_back(z);
+  }
 
-  for(int t = 0; t < num_dtrees; ++t) {
-    DTree &dt = dtrees[t];
-    int e;
-    switch(dt.get_type(w)) {
-    case DTree::Ep:
-      e = dt.get_ep(w);
-      ++ctz[t][z];
-      ++ctze[t][z][e];
-      break;
-    case DTree::None:
-      ++ctz[t][z];
-      break;
+  const vector<int> &eps = word_eps[w];
+  for(size_t i = 0; i < eps.size(); ++i) {
+    cez.inc(eps[i], z);
+  }
+  const vector<int> &nps = word_nps[w];
+  for(size_t i = 0; i < nps.size(); ++i) {
+    cnz.inc(nps[i], z);
+  }
+  update_coefs(z);
+  if(d == bucket_doc) {
+    smooth_mass += alphas[z] * beta * none_coefs[z];
+    doc_mass += cdz.get(d, z) * beta * none_coefs[z];
+  }
+}
+
+int
+LDADF::sample_topic(int d, int w) {
+  // buckets as SparseLDA (Yao et al. 2009): for topics where w is a normal leaf (None),
+  // (cdz + alpha) * (cwz + beta) * none_coef = alpha * beta * none_coef (smoothing)
+  // + cdz * beta * none_coef (document) + cwz * (cdz + alpha) * none_coef (word),
+  // where the first two are summed over topics incrementally and the last one over
+  // topics with cwz > 0; topics where w is Ep or Np (constrained) take exact weights
+  if(!bucketed) {
+    return LDA::sample_topic(d, w);
+  }
+  if(d != bucket_doc) {
+    cache_doc(d);
+  }
+  const int *cw = cwz.row(w, &count_rows[0]);
+  const int *cd = cdz.row(d, &count_rows[num_topics]);
+
+  double smooth = smooth_mass;
+  double doc = doc_mass;
+  double constrained = 0.0;
+  const vector<pair<int, int> > &topics = word_topics[w];
+  for(size_t i = 0; i < topics.size(); ++i) {
+    int z = topics[i].first;
+    smooth -= alphas[z] * beta * none_coefs[z];
+    doc -= cd[z] * beta * none_coefs[z];
+    constrained += (cd[z] + alphas[z]) * calc_prim_weight(w, z, topics[i].second);
+    bucket_cum[i] = constrained;
+    constrained_topics[z] = 1;
+  }
+  smooth = max(smooth, 0.0); // cancellation
+  doc = max(doc, 0.0);
+
+  int num_word_topics = 0;
+  double word = 0.0;
+  const vector<int> &word_nonzeros = nonzero_topics[w];
+  for(size_t i = 0; i < word_nonzeros.size(); ++i) {
+    int z = word_nonzeros[i];
+    if(!constrained_topics[z]) {
+      word += cw[z] * (cd[z] + alphas[z]) * none_coefs[z];
+      probs[num_word_topics] = word;
+      bucket_topics[num_word_topics++] = z;
+    }
+  }
+
+  double buckets[4] = {word, word + constrained, word + constrained + doc, word + constrained + doc + smooth};
+  int b = multi_cum(buckets, 4);
+  int z;
+  if(b == 0) {
+    z = bucket_topics[multi_cum(&probs[0], num_word_topics)];
+  } else if(b == 1) {
+    z = topics[multi_cum(&bucket_cum[0], topics.size())].first;
+  } else {
+    double s = 0.0; // the rare buckets over all topics
+    for(int k = 0; k < num_topics; ++k) {
+      if(!constrained_topics[k]) {
+        s += (b == 2 ? cd[k] : alphas[k]) * beta * none_coefs[k];
+      }
+      probs[k] = s;
     }
+    z = multi_cum(&probs[0], num_topics);
   }
+  for(size_t i = 0; i < topics.size(); ++i) {
+    constrained_topics[topics[i].first] = 0;
+  }
+  return z;
 }
 
 void
 LDADF::calc_probs(int d, int w, vector<double> &probs) {
   for(int z = 0; z < num_topics; ++z) {
-    probs[z] = (cdz[d][z] + alphas[z]);
+    probs[z] = (cdz.get(d, z) + alphas[z]);
     probs[z] *= calc_prob_weight(w, z);
   }
   norm(probs);
 }
 
+double
+LDADF::calc_weights(int d, int w, vector<double> &cum) {
+  // calc_probs() by the cached coefficients for normal leaves, without normalization,
+  // overwriting the weights of topics where w is Ep or Np before they are accumulated
+  // (not by cum_prod_ratio() of LDA, which divides by counts of topics instead of
+  // multiplying by coefficients, and fuses the prefix sum before the overwrites)
+  const int *cw = cwz.row(w, &count_rows[0]);
+  const int *cd = cdz.row(d, &count_rows[num_topics]);
+  for(int z = 0; z < num_topics; ++z) {
+    cum[z] = (cd[z] + alphas[z]) * (cw[z] + beta) * none_coefs[z];
+  }
+  const vector<pair<int, int> > &topics = word_topics[w];
+  for(size_t i = 0; i < topics.size(); ++i) {
+    int z = topics[i].first;
+    cum[z] = (cd[z] + alphas[z]) * calc_prim_weight(w, z, topics[i].second);
+  }
+  for(int z = 1; z < num_topics; ++z) {
+    cum[z] += cum[z-1];
+  }
+  return cum[num_topics-1];
+}
+
 void
 LDADF::get_phi(vector<vector<double> > &phi) {
   for(int z = 0; z < num_topics; ++z) {
@@ -137,29 +301,113 @@ LDADF::save_params(const string &out_base) {
   save_matrix(dti_file, mat);
 }
 
+void
+LDADF::share_data(const LDA &other) {
+  // read-only docs, and dtrees already parsed (and compacted) from the same dnf without
+  // copies, instead of load_dnf()
+  LDA::share_data(other);
+  const LDADF *o = dynamic_cast<const LDADF*>(&other);
+  if(o != NULL && dnf_file != "" && o->dnf_file == dnf_file && o->parsed_dtrees) {
+    dnf_file = "";
+    parsed_dtrees = o->parsed_dtrees;
+    dtrees = o->dtrees;
+    num_dtrees = dtrees->size();
+  }
+}
+
 void
 LDADF::load_dnf(const string &filename) {
   ifstream in(filename.c_str());
   if(!in.is_open()) {
-    cerr << "LDADF::load_dnf(): cannot open " << filename << endl;
-    exit(1);
+    throw runtime_error(string("LDADF::load_dnf(): cannot open ") + filename);
   }
 
   string line;
+  vector<string> dnf;
   while(getline(in, line)) {
+    dnf.push_back(line);
+  }
+  set_dnf(dnf);
+}
+
+void
+LDADF::set_dnf(const vector<string> &dnf) {
+  shared_ptr<vector<DTree> > parsed(new vector<DTree>());
+  for(vector<string>::const_iterator i = dnf.begin(); i != dnf.end(); ++i) {
     DTree dtree;
-    dtree.parse(line);
+    dtree.parse(*i);
     comment("- tree: " + dtree.str());
-    dtrees.push_back(dtree);
+    parsed->push_back(dtree);
   }
-  num_dtrees = dtrees.size();
+  parsed_dtrees = parsed;
+  dtrees = parsed;
+  num_dtrees = parsed->size();
+}
+
+// share count tables among dtrees with the same ep or np word sets
+void
+LDADF::index_dtrees() {
+  map<vector<int>, int> ep_idx, np_idx;
+  set<int> words;
+  dtree_eps.assign(num_dtrees, vector<int>());
+  dtree_np.assign(num_dtrees, 0);
+  word_eps.assign(num_words, vector<int>());
+  word_nps.assign(num_words, vector<int>());
+  for(int t = 0; t < num_dtrees; ++t) {
+    const DTree &dt = (*dtrees)[t];
+    vector<int> dt_words(dt.np);
+    for(size_t e = 0; e < dt.eps.size(); ++e) {
+      dt_words.insert(dt_words.end(), dt.eps[e].begin(), dt.eps[e].end());
+    }
+    for(size_t j = 0; j < dt_words.size(); ++j) {
+      if(dt_words[j] >= num_words) {
+        throw runtime_error("LDADF::index_dtrees(): word " + str(dt_words[j]) + " of " + dnf_file
+                            + " is out of words in the data (" + str(num_words) + ")");
+      }
+    }
+    for(size_t e = 0; e < dt.eps.size(); ++e) {
+      vector<int> ep(dt.eps[e]);
+      sort(ep.begin(), ep.end());
+      if(ep_idx.count(ep) == 0) {
+        int i = ep_idx.size();
+        ep_idx[ep] = i;
+        for(size_t j = 0; j < ep.size(); ++j) {
+          word_eps[ep[j]].push_back(i);
+        }
+        words.insert(ep.begin(), ep.end());
+      }
+      dtree_eps[t].push_back(ep_idx[ep]);
+    }
+
+    vector<int> np(dt.np);
+    sort(np.begin(), np.end());
+    if(np_idx.count(np) == 0) {
+      int i = np_idx.size();
+      np_idx[np] = i;
+      for(size_t j = 0; j < np.size(); ++j) {
+        word_nps[np[j]].push_back(i);
+      }
+    }
+    dtree_np[t] = np_idx[np];
+  }
+  ep_words.assign(words.begin(), words.end());
+
+  cez.assign(ep_idx.size(), num_topics, compact_counts);
+  cnz.assign(np_idx.size(), num_topics, compact_counts);
 }
 
 void
 LDADF::calc_dtree_probs(int z, vector<double> &dtree_probs) {
   assert(dtree_probs.size() == num_dtrees);
+  double base = calc_dtree_base_weight(z);
+  for(size_t i = 0; i < ep_words.size(); ++i) {
+    int w = ep_words[i];
+    ep_word_weights[w] = (lgamma(cwz.get(w, z) + beta * eta) - lgamma(beta * eta))
+      - (lgamma(cwz.get(w, z) + beta) - lgamma(beta));
+  }
   for(int t = 0; t < num_dtrees; ++t) {
-    dtree_probs[t] = calc_dtree_prob_weight(z, t);
+    dtree_weights[t] = base + calc_dtree_delta_weight(z, t);
+    dtree_probs[t] = dtree_weights[t];
   }
 
   // logsumexp trick
@@ -172,7 +420,7 @@ LDADF::calc_dtree_probs(int z, vector<double> &dtree_probs) {
 
 double
 LDADF::calc_dtree_prob_weight(int z, int t) {
-  DTree &dt = dtrees[t];
+  const DTree &dt = (*dtrees)[t];
   int num_np = dt.np.size();
   int num_nonp = num_words - num_np;
 
@@ -181,32 +429,41 @@ LDADF::calc_dtree_prob_weight(int z, int t) {
 
   // root node
   prob += lgamma(beta * eta * num_nonp + beta * num_np) - lgamma(cz[z] + beta * eta * num_nonp + beta * num_np);
-  prob += (lgamma(ctz[t][z] + beta * eta * num_nonp) - lgamma(beta * eta * num_nonp));
+  prob += (lgamma(get_ctz(t, z) + beta * eta * num_nonp) - lgamma(beta * eta * num_nonp));
   for(int j = 0; j < num_np; ++j) {
     int w = dt.np[j];
-    prob += lgamma(cwz[w][z] + beta) - lgamma(beta);
+    prob += lgamma(cwz.get(w, z) + beta) - lgamma(beta);
   }
 
   // non-np node
-  prob += lgamma(beta * num_nonp) - lgamma(ctz[t][z] + beta * num_nonp);
+  prob += lgamma(beta * num_nonp) - lgamma(get_ctz(t, z) + beta * num_nonp);
+  vector<bool> leaves(num_words, true); // normal leaves, without map lookups of DTree::get_type()
+  for(int j = 0; j < num_np; ++j) {
+    leaves[dt.np[j]] = false;
+  }
+  for(size_t e = 0; e < dt.eps.size(); ++e) {
+    for(size_t i = 0; i < dt.eps[e].size(); ++i) {
+      leaves[dt.eps[e][i]] = false;
+    }
+  }
   for(int w = 0; w < num_words; ++w) {
-    if(dt.get_type(w) == DTree::None) {
-      prob += lgamma(cwz[w][z] + beta) - lgamma(beta);
+    if(leaves[w]) {
+      prob += lgamma(cwz.get(w, z) + beta) - lgamma(beta);
     }
   }
   int num_eps = dt.eps.size();
   for(int e = 0; e < num_eps; ++e) {
     int num_ep = dt.eps[e].size();
-    prob += lgamma(ctze[t][z][e] + beta * num_ep) - lgamma(beta * num_ep);
+    prob += lgamma(get_ctze(t, z, e) + beta * num_ep) - lgamma(beta * num_ep);
   }
 
   // eps node
   for(int e = 0; e < num_eps; ++e) {
     int num_ep = dt.eps[e].size();
-    prob += lgamma(beta * eta * num_ep) - lgamma(ctze[t][z][e] + beta * eta * num_ep);
+    prob += lgamma(beta * eta * num_ep) - lgamma(get_ctze(t, z, e) + beta * eta * num_ep);
     for(int i = 0; i < num_ep; ++i) {
       int w = dt.eps[e][i];
-      prob += lgamma(cwz[w][z] + beta * eta) - lgamma(beta * eta);
+      prob += lgamma(cwz.get(w, z) + beta * eta) - lgamma(beta * eta);
     }
   }
 
@@ -214,36 +471,207 @@ LDADF::calc_dtree_prob_weight(int z, int t) {
 }
 
 double
-LDADF::calc_prob_weight(int w, int z) {
-  int t = dz[z];
-  DTree &dt = dtrees[t];
+LDADF::calc_topic_log_likelihood(int z) {
+  // log p(words assigned to z, dtree of z | z)
+  return calc_dtree_prob_weight(z, dz[z]);
+}
+
+void
+LDADF::copy_counts(const LDA &other) {
+  LDA::copy_counts(other);
+  const LDADF &o = dynamic_cast<const LDADF &>(other);
+  cez = o.cez;
+  cnz = o.cnz;
+  dz = o.dz;
+  refresh_coefs();
+  index_word_topics();
+}
+
+void
+LDADF::merge_counts(const vector<shared_ptr<LDA> > &workers) {
+  LDA::merge_counts(workers);
+  CountMatrix *counts[] = {&cez, &cnz};
+  for(int m = 0; m < 2; ++m) {
+    CountMatrix &c = *counts[m];
+    for(int i = 0; i < c.size(); ++i) {
+      for(int z = 0; z < num_topics; ++z) {
+        int x = c.get(i, z);
+        int s = x;
+        for(size_t t = 0; t < workers.size(); ++t) {
+          const LDADF &worker = static_cast<const LDADF &>(*workers[t]);
+          s += (m == 0 ? worker.cez : worker.cnz).get(i, z) - x;
+        }
+        if(s != x) c.set(i, z, s);
+      }
+    }
+  }
+  refresh_coefs();
+  index_word_topics();
+}
+
+// common part of calc_dtree_prob_weight() over dtrees, which treats all words as leaves
+// directly under the root or non-np node
+double
+LDADF::calc_dtree_base_weight(int z) {
+  double prob = 0.0;
+  for(int w = 0; w < num_words; ++w) {
+    prob += lgamma(cwz.get(w, z) + beta) - lgamma(beta);
+  }
+  return prob;
+}
+
+// calc_dtree_prob_weight() - calc_dtree_base_weight(), which costs O(#words in eps)
+// instead of O(#words) given ep_word_weights for topic z
+double
+LDADF::calc_dtree_delta_weight(int z, int t) {
+  const DTree &dt = (*dtrees)[t];
   int num_np = dt.np.size();
   int num_nonp = num_words - num_np;
 
-  double prob;
-  int e, num_ep;
-  switch(dt.get_type(w)) {
-  case DTree::Ep:
-    e = dt.get_ep(w);
-    num_ep = dt.eps[e].size();
-    prob = (cwz[w][z] + beta * eta);
-    prob /= (ctze[t][z][e] + beta * eta * num_ep);
-    prob *= (ctze[t][z][e] + beta * num_ep);
-    prob /= (ctz[t][z] + beta * num_nonp);
-    prob *= (ctz[t][z] + beta * eta * num_nonp);
-    prob /= (cz[z] + beta * eta * num_nonp + beta * num_np);      
-    break;
-  case DTree::Np:
-    prob = (cwz[w][z] + beta);
-    prob /= (cz[z] + beta * eta * num_nonp + beta * num_np);
-    break;
-  case DTree::None:
-    prob = (cwz[w][z] + beta);
-    prob /= (ctz[t][z] + beta * num_nonp);
-    prob *= (ctz[t][z] + beta * eta * num_nonp);
-    prob /= (cz[z] + beta * eta * num_nonp + beta * num_np);
-    break;
+  // size
+  double prob = log(num_nonp);
+
+  // root node (np leaves are in the base)
+  prob += lgamma(beta * eta * num_nonp + beta * num_np) - lgamma(cz[z] + beta * eta * num_nonp + beta * num_np);
+  prob += (lgamma(get_ctz(t, z) + beta * eta * num_nonp) - lgamma(beta * eta * num_nonp));
+
+  // non-np node (normal leaves are in the base)
+  prob += lgamma(beta * num_nonp) - lgamma(get_ctz(t, z) + beta * num_nonp);
+  int num_eps = dt.eps.size();
+  for(int e = 0; e < num_eps; ++e) {
+    int num_ep = dt.eps[e].size();
+    prob += lgamma(get_ctze(t, z, e) + beta * num_ep) - lgamma(beta * num_ep);
   }
 
+  // eps node (replacing normal leaves in the base)
+  for(int e = 0; e < num_eps; ++e) {
+    int num_ep = dt.eps[e].size();
+    prob += lgamma(beta * eta * num_ep) - lgamma(get_ctze(t, z, e) + beta * eta * num_ep);
+    for(int i = 0; i < num_ep; ++i) {
+      prob += ep_word_weights[dt.eps[e][i]];
+    }
+  }
+
+  return prob;
+}
+
+double
+LDADF::calc_prob_weight(int w, int z) {
+  return calc_prim_weight(w, z, get_prim(w, z));
+}
+
+int
+LDADF::get_prim(int w, int z) {
+  // e if w is in e-th ep of dtree dz[z], PRIM_NP if in its np, or PRIM_NONE
+  const vector<pair<int, int> > &topics = word_topics[w];
+  if(topics.empty()) return PRIM_NONE; // most words
+  vector<pair<int, int> >::const_iterator i = lower_bound(topics.begin(), topics.end(), make_pair(z, PRIM_NP));
+  return i != topics.end() && i->first == z ? i->second : PRIM_NONE;
+}
+
+double
+LDADF::calc_prim_weight(int w, int z, int prim) {
+  // by the factors cached in update_coefs(), in the same order of operations
+  double prob;
+  if(prim == PRIM_NONE) {
+    prob = (cwz.get(w, z) + beta);
+    prob /= nonp_denoms[z];
+    prob *= nonp_nums[z];
+    prob /= root_denoms[z];
+  } else if(prim == PRIM_NP) {
+    prob = (cwz.get(w, z) + beta);
+    prob /= root_denoms[z];
+  } else {
+    int t = dz[z];
+    int e = prim;
+    int num_ep = (*dtrees)[t].eps[e].size();
+    prob = (cwz.get(w, z) + beta * eta);
+    prob /= (get_ctze(t, z, e) + beta * eta * num_ep);
+    prob *= (get_ctze(t, z, e) + beta * num_ep);
+    prob /= nonp_denoms[z];
+    prob *= nonp_nums[z];
+    prob /= root_denoms[z];
+  }
   return prob;
 }
+
+void
+LDADF::code_topic(int z) {
+  // word_topics of topic z from the dtree coded before to dz[z]
+  for(int k = 0; k < 2; ++k) {
+    int t = k == 0 ? coded_dz[z] : dz[z];
+    if(t < 0) continue;
+    const DTree &dt = (*dtrees)[t];
+    vector<pair<int, int> > prims; // (word, primitive) in dtree t, where Np overrides Ep as in DTree::get_type()
+    for(size_t e = 0; e < dt.eps.size(); ++e) {
+      for(size_t j = 0; j < dt.eps[e].size(); ++j) {
+        prims.push_back(make_pair(dt.eps[e][j], static_cast<int>(e)));
+      }
+    }
+    for(size_t j = 0; j < dt.np.size(); ++j) {
+      prims.push_back(make_pair(dt.np[j], PRIM_NP));
+    }
+    for(size_t j = 0; j < prims.size(); ++j) {
+      vector<pair<int, int> > &topics = word_topics[prims[j].first];
+      vector<pair<int, int> >::iterator i = lower_bound(topics.begin(), topics.end(), make_pair(z, PRIM_NP));
+      bool found = i != topics.end() && i->first == z;
+      if(k == 0) {
+        if(found) topics.erase(i);
+      } else if(found) {
+        i->second = prims[j].second;
+      } else {
+        topics.insert(i, make_pair(z, prims[j].second));
+      }
+    }
+  }
+  coded_dz[z] = dz[z];
+}
+
+void
+LDADF::update_coefs(int z) {
+  // factors of calc_prob_weight() for topic z after its counts (or dtree) are changed
+  if(coded_dz[z] != dz[z]) {
+    code_topic(z);
+  }
+  int t = dz[z];
+  int num_np = (*dtrees)[t].np.size();
+  int num_nonp = num_words - num_np;
+  root_denoms[z] = cz[z] + beta * eta * num_nonp + beta * num_np;
+  nonp_denoms[z] = get_ctz(t, z) + beta * num_nonp;
+  nonp_nums[z] = get_ctz(t, z) + beta * eta * num_nonp;
+  none_coefs[z] = nonp_nums[z] / nonp_denoms[z] / root_denoms[z];
+}
+
+void
+LDADF::refresh_coefs() {
+  // all topics, e.g. after dtrees are sampled or counts are copied
+  for(int z = 0; z < num_topics; ++z) {
+    update_coefs(z);
+  }
+  bucket_doc = -1;
+}
+
+void
+LDADF::index_word_topics() {
+  // nonzero_topics from cwz, e.g. after counts are copied
+  nonzero_topics.assign(num_words, vector<int>());
+  if(!bucketed) return;
+  for(int w = 0; w < num_words; ++w) {
+    for(int z = 0; z < num_topics; ++z) {
+      if(cwz.get(w, z) > 0) nonzero_topics[w].push_back(z);
+    }
+  }
+}
+
+void
+LDADF::cache_doc(int d) {
+  // smoothing and document buckets summed over all topics, updated by resample_pre/post()
+  // while tokens of document d are sampled
+  bucket_doc = d;
+  smooth_mass = 0.0;
+  doc_mass = 0.0;
+  for(int z = 0; z < num_topics; ++z) {
+    smooth_mass += alphas[z] * beta * none_coefs[z];
+    doc_mass += cdz.get(d, z) * beta * none_coefs[z];
+  }
+}
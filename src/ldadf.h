@@ -2,6 +2,7 @@
 #define LDADF_H
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "lda.h"
@@ -9,6 +10,9 @@
 
 class LDADF : public LDA {
   friend class TestLDADF;
+  friend class LDABinding;
+  friend class LDAGrid;
+  friend class TestLDAGrid;
 
  public:
   LDADF() {};
@@ -19,11 +23,16 @@ class LDADF : public LDA {
   virtual void initialize();
   virtual void preprocess();
 
+  virtual void set_dnf(const std::vector<std::string> &dnf); // lines of .dnf, instead of load_dnf()
+  virtual void share_data(const LDA &other);
+
  protected:
   virtual void resample();
   virtual void resample_pre(int d, int w, int z);
   virtual void resample_post(int d, int w, int z);
+  virtual int sample_topic(int d, int w);
   virtual void calc_probs(int d, int w, std::vector<double> &probs);
+  virtual double calc_weights(int d, int w, std::vector<double> &cum);
 
   virtual void get_phi(std::vector<std::vector<double> > &phi);
   virtual void save_params(const std::string &out_base);
@@ -31,7 +40,27 @@ class LDADF : public LDA {
   virtual void load_dnf(const std::string &filename);
   virtual void calc_dtree_probs(int z, std::vector<double> &dtree_probs);
   virtual double calc_dtree_prob_weight(int z, int t);
+  virtual double calc_dtree_base_weight(int z);
+  virtual double calc_dtree_delta_weight(int z, int t);
   virtual double calc_prob_weight(int w, int z);
+  double calc_prim_weight(int w, int z, int prim); // calc_prob_weight() given get_prim(w, z)
+  int get_prim(int w, int z);
+  virtual double calc_topic_log_likelihood(int z);
+  virtual LDA *clone() const { return new LDADF(*this); }
+  virtual void copy_counts(const LDA &other);
+  virtual void merge_counts(const std::vector<std::shared_ptr<LDA> > &workers);
+  virtual void begin_task() { bucket_doc = -1; } // documents of the task are renumbered from 0
+  void index_dtrees();
+  void code_topic(int z);
+  void update_coefs(int z);
+  void refresh_coefs();
+  void cache_doc(int d);
+  void index_word_topics();
+
+  // ctz = count of topic z for non-np words in dtree t
+  int get_ctz(int t, int z) { return cz[z] - cnz.get(dtree_np[t], z); }
+  // ctze = count of topic z for words in e-th ep in dtree t
+  int get_ctze(int t, int z, int e) { return cez.get(dtree_eps[t][e], z); }
 
  protected:
   // arguments
@@ -40,15 +69,45 @@ class LDADF : public LDA {
 
   // dforest
   int num_dtrees;
-  std::vector<DTree> dtrees;
+  std::shared_ptr<const std::vector<DTree> > dtrees; // read-only, shared by workers and grid configs
+  std::shared_ptr<const std::vector<DTree> > parsed_dtrees; // in word ids of the data (before compact_words())
+  std::vector<std::vector<int> > dtree_eps; // dtree_eps[t][e] = index of distinct ep for e-th ep in dtree t
+  std::vector<int> dtree_np; // dtree_np[t] = index of distinct np for dtree t
+  std::vector<std::vector<int> > word_eps; // word_eps[w] = indices of distinct eps including w
+  std::vector<std::vector<int> > word_nps; // word_nps[w] = indices of distinct nps including w
+  std::vector<int> ep_words; // words in eps of any dtree
+
+  // primitives of words in the dtrees assigned to topics, instead of DTree::get_type()
+  static constexpr int PRIM_NONE = -1;
+  static constexpr int PRIM_NP = -2;
+  std::vector<int> coded_dz; // coded_dz[z] = dtree of topic z in word_topics (-1 if none)
+  std::vector<std::vector<std::pair<int, int> > > word_topics; // word_topics[w] = (z, e or PRIM_NP) in order of z, for topics whose dtree has w as e-th Ep or Np
 
   // counts for inference
   std::vector<int> dz; // dz[z] = index of dtree assigned for topic z
-  std::vector<std::vector<int> > ctz; // ctz[t][z] = count of topic z for non-np words in dtree t
-  std::vector<std::vector<std::vector<int> > > ctze; // ceps[t][z][e] = count of topic z for words in e-th ep in dtree t
+  CountMatrix cez; // cez.get(i, z) = count of topic z for words in i-th distinct ep
+  CountMatrix cnz; // cnz.get(i, z) = count of topic z for words in i-th distinct np
+
+  // factors of calc_prob_weight() for topic z and dtree dz[z], updated with cz and cnz
+  std::vector<double> root_denoms; // root_denoms[z] = cz + beta * eta * num_nonp + beta * num_np
+  std::vector<double> nonp_denoms; // nonp_denoms[z] = ctz + beta * num_nonp
+  std::vector<double> nonp_nums; // nonp_nums[z] = ctz + beta * eta * num_nonp
+  std::vector<double> none_coefs; // none_coefs[z] = nonp_nums[z] / nonp_denoms[z] / root_denoms[z]
+
+  // buckets of sample_topic() summed over topics for words as normal leaves
+  bool bucketed; // sample by buckets instead of the dense conditional (for many topics)
+  std::vector<std::vector<int> > nonzero_topics; // nonzero_topics[w] = topics z with cwz(w, z) > 0
+  int bucket_doc; // document of doc_mass, or -1 if the sums are stale
+  double smooth_mass; // sum of alpha_z * beta * none_coefs[z]
+  double doc_mass; // sum of cdz(bucket_doc, z) * beta * none_coefs[z]
 
   // temporary memory
   std::vector<double> dtree_probs;
+  std::vector<double> dtree_weights; // dtree_weights[t] = log weight of dtree t in the last calc_dtree_probs()
+  std::vector<double> ep_word_weights; // ep_word_weights[w] = log weight of w as ep word instead of normal leaf
+  std::vector<int> bucket_topics; // topics of the word bucket in the last sample_topic()
+  std::vector<char> constrained_topics; // constrained_topics[z] = 1 if the word in sample_topic() is Ep or Np in topic z
+  std::vector<double> bucket_cum; // cumulative weights of constrained topics in the last sample_topic()
 };
 
 #endif
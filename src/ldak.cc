@@ -0,0 +1,66 @@
+#include "ldak.h"
+
+#include <cassert>
+
+#include <array>
+using namespace std;
+
+#include "utils.h"
+using namespace ldautils;
+
+template <int K>
+LDADFK<K>::LDADFK(string data_file_, string out_base_, double alpha_, double beta_,
+                  int max_steps_, int num_loops_, int burn_in_, bool converge_, int rand_seed_, bool verbose_,
+                  string dnf_file_, double eta_)
+  : LDADF(data_file_, out_base_, K, alpha_, beta_,
+          max_steps_, num_loops_, burn_in_, converge_, rand_seed_, verbose_,
+          dnf_file_, eta_) {
+
+  comment("- specialized on num topics: " + str(K));
+}
+
+template <int K>
+int
+LDADFK<K>::sample_topic(int d, int w) {
+  // the dense conditional, as K is below the threshold of buckets in LDADF
+  array<double, K> cum; // on the stack
+  array<int, K> cw_buf, cd_buf; // for compact counts
+  const int *cw = cwz.row(w, cw_buf.data());
+  const int *cd = cdz.row(d, cd_buf.data());
+  const double *as = &alphas[0];
+  const double *coefs = &none_coefs[0];
+  for(int j = 0; j < K; ++j) {
+    cum[j] = (cd[j] + as[j]) * (cw[j] + beta) * coefs[j];
+  }
+  const vector<pair<int, int> > &topics = word_topics[w]; // Ep or Np
+  for(size_t i = 0; i < topics.size(); ++i) {
+    int j = topics[i].first;
+    cum[j] = (cd[j] + as[j]) * calc_prim_weight(w, j, topics[i].second);
+  }
+  for(int j = 1; j < K; ++j) {
+    cum[j] += cum[j-1];
+  }
+  return multi_cum(cum.data(), K);
+}
+
+LDA *
+create_lda(string data_file, string out_base, int num_topics, double alpha, double beta,
+           int max_steps, int num_loops, int burn_in, bool converge, int rand_seed, bool verbose,
+           string dnf_file, double eta) {
+  if(dnf_file != "") {
+    switch(num_topics) {
+    case 16:
+      return new LDADFK<16>(data_file, out_base, alpha, beta, max_steps, num_loops, burn_in, converge, rand_seed, verbose, dnf_file, eta);
+    case 32:
+      return new LDADFK<32>(data_file, out_base, alpha, beta, max_steps, num_loops, burn_in, converge, rand_seed, verbose, dnf_file, eta);
+    } // others (e.g. 64 topics, sampled by buckets) by the generic LDADF
+    return new LDADF(data_file, out_base, num_topics, alpha, beta,
+                     max_steps, num_loops, burn_in, converge, rand_seed, verbose, dnf_file, eta);
+  }
+  return new LDA(data_file, out_base, num_topics, alpha, beta,
+                 max_steps, num_loops, burn_in, converge, rand_seed, verbose);
+}
+
+/* for linking */
+template class LDADFK<16>;
+template class LDADFK<32>;
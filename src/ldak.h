@@ -0,0 +1,34 @@
+#ifndef LDAK_H
+#define LDAK_H
+
+#include <string>
+#include <vector>
+
+#include "lda.h"
+#include "ldadf.h"
+
+// sampler of LDADF specialized on a compile-time number of topics K, where the dense
+// conditional is kept on the stack and its loops are unrolled on K (LDA is not specialized,
+// as its SIMD kernel is as fast without a compile-time K)
+
+template <int K>
+class LDADFK : public LDADF {
+  friend class TestLDAK;
+
+ public:
+  LDADFK() {};
+  LDADFK(std::string data_file, std::string out_base = "", double alpha = 0.1, double beta = 0.1,
+         int max_steps = 100, int num_loops = 0, int burn_in = 5, bool converge = false, int rand_seed = 0, bool verbose = false,
+         std::string dnf_file = "", double eta = 100);
+
+ protected:
+  virtual int sample_topic(int d, int w);
+  virtual LDA *clone() const { return new LDADFK<K>(*this); }
+};
+
+// dispatcher to the specialized samplers (K = 16, 32) of LDADF or the generic LDA/LDADF
+LDA *create_lda(std::string data_file, std::string out_base = "", int num_topics = 10, double alpha = 0.1, double beta = 0.1,
+                int max_steps = 100, int num_loops = 0, int burn_in = 5, bool converge = false, int rand_seed = 0, bool verbose = false,
+                std::string dnf_file = "", double eta = 100);
+
+#endif
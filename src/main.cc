@@ -1,10 +1,16 @@
-#include "ldadf.h"
+#include "chains.h"
+#include "grid.h"
+#include "heldout.h"
+#include "ldak.h"
+#include "utils.h"
 
 #include <cstdlib>
 #include <ctime>
 
 #include <iostream>
+#include <stdexcept>
 using namespace std;
+using namespace ldautils;
 
 #include <getopt.h>
 
@@ -22,10 +28,61 @@ main(int argc, char *argv[]) {
   bool verbose = false;
   string dnf_file = "";
   double eta = 10;
+  string metrics_file = "";
+  bool grouped = false;
+  bool word_major = false;
+  int average_every = 0;
+  bool compact = false;
+  bool compact_words = false;
+  int num_chains = 1;
+  double rhat_limit = 1.1;
+  int num_threads = 1;
+  bool conditional_init = false;
+  int chunk_size = 10000;
+  int top_k = 0;
+  double threshold = 0.0;
+  string warm_start = "";
+  string resume = "";
+  string append_file = "";
+  double old_rate = 1.0;
+  bool save_state = false;
+  double time_budget = 0.0;
+  string grid_n = "";
+  string grid_a = "";
+  string grid_b = "";
+  string grid_e = "";
+  int grid_threads = 1;
+  string heldout_file = "";
+  string eval_base = "";
+  int num_particles = 10;
+  bool completion = false;
   bool help = false;
 
+  const struct option long_options[] = {
+    {"chains", required_argument, NULL, 'C'},
+    {"rhat", required_argument, NULL, 'R'},
+    {"chunk", required_argument, NULL, 'K'},
+    {"top-k", required_argument, NULL, 'T'},
+    {"threshold", required_argument, NULL, 'H'},
+    {"warm-start", required_argument, NULL, 'W'},
+    {"resume", required_argument, NULL, 'U'},
+    {"append", required_argument, NULL, 'P'},
+    {"old-rate", required_argument, NULL, 'O'},
+    {"save-state", no_argument, NULL, 'S'},
+    {"time-budget", required_argument, NULL, 'B'},
+    {"grid-n", required_argument, NULL, 'N'},
+    {"grid-a", required_argument, NULL, 'X'},
+    {"grid-b", required_argument, NULL, 'Y'},
+    {"grid-e", required_argument, NULL, 'Z'},
+    {"grid-threads", required_argument, NULL, 'G'},
+    {"heldout", required_argument, NULL, 'D'},
+    {"eval", required_argument, NULL, 'E'},
+    {"particles", required_argument, NULL, 'p'},
+    {"completion", no_argument, NULL, 'q'},
+    {NULL, 0, NULL, 0}
+  };
   int result;
-  while((result=getopt(argc, argv, "o:n:a:b:m:l:u:cs:vd:e:h")) != -1){
+  while((result=getopt_long(argc, argv, "o:n:a:b:m:l:u:cs:vd:e:M:gwA:kVt:Ih", long_options, NULL)) != -1){
     switch(result){
     case 'o':
       out_base = optarg;
@@ -63,6 +120,90 @@ main(int argc, char *argv[]) {
     case 'e':
       eta = atof(optarg);
       break;
+    case 'M':
+      metrics_file = optarg;
+      break;
+    case 'g':
+      grouped = true;
+      break;
+    case 'w':
+      word_major = true;
+      break;
+    case 'A':
+      average_every = atoi(optarg);
+      break;
+    case 'k':
+      compact = true;
+      break;
+    case 'V':
+      compact_words = true;
+      break;
+    case 't':
+      num_threads = atoi(optarg);
+      break;
+    case 'I':
+      conditional_init = true;
+      break;
+    case 'K':
+      chunk_size = atoi(optarg);
+      break;
+    case 'T':
+      top_k = atoi(optarg);
+      break;
+    case 'H':
+      threshold = atof(optarg);
+      break;
+    case 'W':
+      warm_start = optarg;
+      break;
+    case 'U':
+      resume = optarg;
+      break;
+    case 'P':
+      append_file = optarg;
+      break;
+    case 'O':
+      old_rate = atof(optarg);
+      break;
+    case 'S':
+      save_state = true;
+      break;
+    case 'B':
+      time_budget = atof(optarg);
+      break;
+    case 'N':
+      grid_n = optarg;
+      break;
+    case 'X':
+      grid_a = optarg;
+      break;
+    case 'Y':
+      grid_b = optarg;
+      break;
+    case 'Z':
+      grid_e = optarg;
+      break;
+    case 'G':
+      grid_threads = atoi(optarg);
+      break;
+    case 'D':
+      heldout_file = optarg;
+      break;
+    case 'E':
+      eval_base = optarg;
+      break;
+    case 'p':
+      num_particles = atoi(optarg);
+      break;
+    case 'q':
+      completion = true;
+      break;
+    case 'C':
+      num_chains = atoi(optarg);
+      break;
+    case 'R':
+      rhat_limit = atof(optarg);
+      break;
     case 'h':
       help = true;
       break;
@@ -70,7 +211,7 @@ main(int argc, char *argv[]) {
   }
 
   vector<string> args(&(argv[optind]), &(argv[argc]));
-  if(args.size() == 0 || help == true) {
+  if((args.size() == 0 && eval_base == "") || help == true) {
     cerr << "usage: ldadf [OPTION..] DATA" << endl;
     cerr << endl;
     cerr << "LDA with logical constraints on words" << endl;
@@ -78,6 +219,10 @@ main(int argc, char *argv[]) {
     cerr << "examples:" << endl;
     cerr << "./src/ldadf -n2 -m100 -o out/test -v data/test.dat" << endl;
     cerr << "./src/ldadf -n2 -m100 -o out/test -v -d data/test.dnf -e10 data/test.dat" << endl;
+    cerr << "./src/ldadf -n2 -m100 -o out/test -v -c --chains 4 data/test.dat" << endl;
+    cerr << "./src/ldadf -m100 -o out/test -v --grid-n 2,4 --grid-a 0.1,1 --grid-threads 4 data/test.dat" << endl;
+    cerr << "./src/ldadf -n2 -m100 -o out/test -v --heldout data/test.dat data/test.dat" << endl;
+    cerr << "./src/ldadf -a1 -t4 -v --eval out/test.final --heldout data/test.dat" << endl;
     cerr << endl;
     cerr << "optional arguments" << endl;
     cerr << "  -o    output path (prefix for .phi/.theta/.dti/.smp)" << endl;
@@ -87,27 +232,197 @@ main(int argc, char *argv[]) {
     cerr << "  -m    maximum number of training steps" << endl;
     cerr << "  -l    number of inner loops" << endl;
     cerr << "  -u    number of burn-in steps" << endl;
-    cerr << "  -c    stop training if perplexity does not change" << endl;
+    cerr << "  -c    stop training if joint log-likelihood does not change" << endl;
     cerr << "  -s    seed of random function" << endl;
     cerr << "  -v    verbose mode" << endl;
     cerr << "  -d    file (.dnf) including compiled dnf from constraint linkes" << endl;
     cerr << "  -e    strength parameter eta of constraint links" << endl;
+    cerr << "  -M    file to save metrics of each step (json lines)" << endl;
+    cerr << "  -g    sample repeated words in each document from one shared conditional" << endl;
+    cerr << "  -w    sweep tokens word by word instead of document by document" << endl;
+    cerr << "  -A    average phi/theta over samples taken every A steps after burn-in" << endl;
+    cerr << "  -k    store counts as 16-bit integers (rows are promoted on overflow)" << endl;
+    cerr << "  -V    remap word ids to those present in the data (outputs keep the ids of the data)" << endl;
+    cerr << "  -t    number of threads sampling topics of token ranges (approximately, with counts merged after each step)" << endl;
+    cerr << "  -I    initialize topics by sampling from the conditional of the counts so far (in parallel with -t)" << endl;
     cerr << "  -h    print this message" << endl;
+    cerr << "  --chains N  run N chains (seeds: seed, seed+1, ..) in threads sharing the data," << endl;
+    cerr << "              and save the best one (with -c, stop if R-hat of log-likelihood < --rhat)" << endl;
+    cerr << "  --rhat X    threshold of R-hat to stop chains (default: 1.1)" << endl;
+    cerr << "  --chunk N   max tokens of a task for -t, where longer documents are split (default: 10000)" << endl;
+    cerr << "  --top-k N   write only top-N entries of each topic (.phi) and document (.theta) as index:value," << endl;
+    cerr << "              one line per topic (.phi/.smp) or document (.theta); .smp keeps all non-zero counts" << endl;
+    cerr << "  --threshold X  write only entries >= X of each topic and document (sparse as --top-k)" << endl;
+    cerr << "  --warm-start PREF  initialize topics by the conditional of a prior model (PREF.smp, and PREF.dti for dtrees)" << endl;
+    cerr << "  --save-state  also save topics of tokens (.hz) to be resumed" << endl;
+    cerr << "  --resume PREF  resume from topics (PREF.hz, and PREF.dti for dtrees) of the leading documents of DATA," << endl;
+    cerr << "                 where the following (new) documents are initialized given them" << endl;
+    cerr << "  --append FILE  documents appended to DATA as new ones (with --resume)" << endl;
+    cerr << "  --old-rate R   rate of old documents swept in each step, in rotation (with --resume, default: 1)" << endl;
+    cerr << "  --time-budget SEC  fit steps (up to -m) and burn-in in SEC seconds with the final save," << endl;
+    cerr << "                     checkpointing .final on the way (single chain)" << endl;
+    cerr << "  --grid-n LIST  comma-separated numbers of topics of a grid of configurations (default: -n)," << endl;
+    cerr << "                 each saved with the suffix .nN_aA_bB[_eE] and summarized in PREF.grid" << endl;
+    cerr << "  --grid-a LIST  comma-separated alphas of the grid (default: -a)" << endl;
+    cerr << "  --grid-b LIST  comma-separated betas of the grid (default: -b)" << endl;
+    cerr << "  --grid-e LIST  comma-separated etas of the grid (default: -e, with -d)" << endl;
+    cerr << "  --grid-threads N  number of configurations trained concurrently sharing the data (default: 1)" << endl;
+    cerr << "  --heldout FILE  evaluate the trained model (each one of a grid) on held-out documents (.dat) by" << endl;
+    cerr << "                  left-to-right particles with phi fixed, saving log-likelihoods to .heldout (in -t threads)" << endl;
+    cerr << "  --particles N   particles of left-to-right, or sweeps of --completion (default: 10)" << endl;
+    cerr << "  --completion    evaluate a random half of each held-out document given the rest instead" << endl;
+    cerr << "  --eval PREF     evaluate PREF.phi (with alpha of -a) on --heldout without training" << endl;
     return 1;
   }
 
+  if(eval_base != "") {
+    if(heldout_file == "") {
+      cerr << "--eval needs --heldout" << endl;
+      return 1;
+    }
+    try {
+      set_verbose(verbose);
+      LDAHeldout heldout(eval_base, alpha, num_particles, seed);
+      heldout.set_threads(num_threads);
+      heldout.set_completion(completion);
+      heldout.load_data(heldout_file);
+      double pp = heldout.run();
+      comment("- held-out perplexity: " + str(pp));
+      heldout.save_results((out_base == "" ? eval_base : out_base) + ".heldout");
+    } catch(const exception &e) {
+      cerr << e.what() << endl;
+      return 1;
+    }
+    return 0;
+  }
+
   string data = args[0];
+  if(out_base == "") {
+    out_base = data;
+  }
 
-  if(dnf_file != "") {
-    LDADF lda(data, out_base, num_topics, alpha, beta,
-              max_steps, num_loops, burn_in, converge, seed, verbose,
-              dnf_file, eta);
-    lda.run();
-  } else {
-    LDA lda(data, out_base, num_topics, alpha, beta,
-            max_steps, num_loops, burn_in, converge, seed, verbose);
-    lda.run();
+  // configurations of the grid, or one with -n/-a/-b/-e
+  bool grid = grid_n != "" || grid_a != "" || grid_b != "" || grid_e != "";
+  if(grid && num_chains > 1) {
+    cerr << "--grid-* cannot be used with --chains" << endl;
+    return 1;
+  }
+  if(heldout_file != "" && num_chains > 1) {
+    cerr << "--heldout cannot be used with --chains" << endl;
+    return 1;
+  }
+  vector<string> ns, as, bs, es;
+  split(grid_n != "" ? grid_n : str(num_topics), ',', ns);
+  split(grid_a != "" ? grid_a : str(alpha), ',', as);
+  split(grid_b != "" ? grid_b : str(beta), ',', bs);
+  split(grid_e != "" ? grid_e : str(eta), ',', es);
+  if(dnf_file == "") {
+    es.assign(1, str(eta)); // unused without dnf
+  }
+  vector<vector<string> > configs; // configs[k] = {n, a, b, e}
+  for(size_t i = 0; i < ns.size(); ++i) {
+    for(size_t j = 0; j < as.size(); ++j) {
+      for(size_t k = 0; k < bs.size(); ++k) {
+        for(size_t l = 0; l < es.size(); ++l) {
+          configs.push_back({ns[i], as[j], bs[k], es[l]});
+        }
+      }
+    }
+  }
+  int num_configs = grid ? configs.size() : num_chains;
+
+  vector<LDA*> ldas;
+  for(int c = 0; c < num_configs; ++c) {
+    const vector<string> &config = configs[grid ? c : 0];
+    string base = out_base;
+    string metrics = metrics_file;
+    if(grid) {
+      string suffix = ".n" + config[0] + "_a" + config[1] + "_b" + config[2];
+      if(dnf_file != "") {
+        suffix += "_e" + config[3];
+      }
+      base += suffix;
+      if(metrics != "") {
+        metrics += suffix;
+      }
+    }
+    LDA *lda = create_lda(c == 0 ? data : "", base,
+                          grid ? atoi(config[0].c_str()) : num_topics,
+                          grid ? atof(config[1].c_str()) : alpha,
+                          grid ? atof(config[2].c_str()) : beta,
+                          max_steps, num_loops, burn_in, converge, seed + c, verbose,
+                          dnf_file, grid ? atof(config[3].c_str()) : eta); // specialized on num_topics if possible
+    if(metrics != "") {
+      lda->set_metrics_file(metrics);
+    }
+    if(grouped) {
+      lda->set_grouped(true);
+    }
+    if(word_major) {
+      lda->set_word_major(true);
+    }
+    if(average_every > 0) {
+      lda->set_average_every(average_every);
+    }
+    if(compact) {
+      lda->set_compact_counts(true);
+    }
+    if(compact_words) {
+      lda->set_compact_words(true);
+    }
+    if(num_threads > 1) {
+      lda->set_threads(num_threads, chunk_size);
+    }
+    if(conditional_init) {
+      lda->set_conditional_init(true);
+    }
+    if(top_k > 0 || threshold > 0.0) {
+      lda->set_sparse_output(top_k, threshold);
+    }
+    if(warm_start != "") {
+      lda->set_warm_start(warm_start);
+    }
+    if(resume != "") {
+      lda->set_resume(resume, append_file, old_rate);
+    }
+    if(save_state) {
+      lda->set_save_state(true);
+    }
+    if(time_budget > 0.0) {
+      lda->set_time_budget(time_budget);
+    }
+    ldas.push_back(lda);
+  }
+  int status = 0;
+  try {
+    if(grid) {
+      LDAGrid grid(ldas, grid_threads, out_base + ".grid");
+      if(heldout_file != "") {
+        grid.set_heldout(heldout_file, num_particles, completion);
+      }
+      grid.run();
+    } else if(num_chains > 1) {
+      LDAChains chains(ldas, rhat_limit);
+      chains.run();
+    } else {
+      ldas[0]->run();
+      if(heldout_file != "") {
+        LDAHeldout heldout(*ldas[0], num_particles, seed);
+        heldout.set_threads(num_threads);
+        heldout.set_completion(completion);
+        heldout.load_data(heldout_file);
+        double pp = heldout.run();
+        comment("- held-out perplexity: " + str(pp));
+        heldout.save_results(out_base + ".heldout");
+      }
+    }
+  } catch(const exception &e) {
+    cerr << e.what() << endl;
+    status = 1;
+  }
+  for(int c = 0; c < num_configs; ++c) {
+    delete ldas[c];
   }
 
-  return 0;
+  return status;
 }
@@ -0,0 +1,438 @@
+// Python bindings of LDA/LDADF (cf. setup.py)
+//
+// >>> import pyldadf
+// >>> lda = pyldadf.LDADF(indptr, indices, freqs, num_topics=2, dnf=[';0,1', '0,1;2'], eta=10)
+// >>> lda.run()
+// >>> lda.phi()
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#include <cstring>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "ldak.h"
+
+// accessor of protected members for python objects
+class LDABinding {
+ public:
+  static PyObject *phi(LDA *lda);
+  static PyObject *theta(LDA *lda);
+  static PyObject *cwz(LDA *lda);
+  static PyObject *cdz(LDA *lda);
+  static PyObject *dz(LDA *lda);
+  static double perplexity(LDA *lda) { return lda->calc_perplexity(); }
+  static void save(LDA *lda, const string &out_base) { lda->save_params(out_base); }
+  static bool is_initialized(LDA *lda) { return lda->cwz.size() > 0; }
+  static void set_dnf(LDADF *ldadf, const vector<string> &dnf);
+
+ private:
+  template <typename T> static PyObject *matrix(const vector<vector<T> > &mat, int rows, int cols, int type);
+  static PyObject *matrix(const CountMatrix &mat);
+};
+
+template <typename T>
+PyObject *
+LDABinding::matrix(const vector<vector<T> > &mat, int rows, int cols, int type) {
+  npy_intp dims[2] = {rows, cols};
+  PyObject *array = PyArray_SimpleNew(2, dims, type);
+  if(array == NULL) return NULL;
+  T *data = static_cast<T*>(PyArray_DATA(reinterpret_cast<PyArrayObject*>(array)));
+  for(int i = 0; i < rows; ++i) {
+    memcpy(data + static_cast<size_t>(i) * cols, &mat[i][0], sizeof(T) * cols);
+  }
+  return array;
+}
+
+PyObject *
+LDABinding::matrix(const CountMatrix &mat) {
+  npy_intp dims[2] = {mat.size(), mat.cols()};
+  PyObject *array = PyArray_SimpleNew(2, dims, NPY_INT);
+  if(array == NULL) return NULL;
+  int *data = static_cast<int*>(PyArray_DATA(reinterpret_cast<PyArrayObject*>(array)));
+  for(int i = 0; i < mat.size(); ++i) {
+    int *dst = data + static_cast<size_t>(i) * mat.cols();
+    const int *row = mat.row(i, dst); // widened into dst if compact
+    if(row != dst) memcpy(dst, row, sizeof(int) * mat.cols());
+  }
+  return array;
+}
+
+void
+LDABinding::set_dnf(LDADF *ldadf, const vector<string> &dnf) {
+  ldadf->dnf_file = ""; // not to be loaded in initialize()
+  ldadf->set_dnf(dnf);
+}
+
+PyObject *
+LDABinding::phi(LDA *lda) {
+  lda->get_phi(lda->phi);
+  return matrix(lda->phi, lda->num_topics, lda->num_words, NPY_DOUBLE);
+}
+
+PyObject *
+LDABinding::theta(LDA *lda) {
+  lda->get_theta(lda->theta);
+  return matrix(lda->theta, lda->num_docs, lda->num_topics, NPY_DOUBLE);
+}
+
+PyObject *
+LDABinding::cwz(LDA *lda) {
+  return matrix(lda->cwz);
+}
+
+PyObject *
+LDABinding::cdz(LDA *lda) {
+  return matrix(lda->cdz);
+}
+
+PyObject *
+LDABinding::dz(LDA *lda) {
+  LDADF *ldadf = dynamic_cast<LDADF*>(lda);
+  if(ldadf == NULL) {
+    PyErr_SetString(PyExc_TypeError, "dz is only available for LDADF");
+    return NULL;
+  }
+  vector<vector<int> > mat(1, ldadf->dz);
+  PyObject *array = matrix(mat, 1, ldadf->num_topics, NPY_INT);
+  if(array == NULL) return NULL;
+  PyObject *vec = PyArray_Ravel(reinterpret_cast<PyArrayObject*>(array), NPY_CORDER);
+  Py_DECREF(array);
+  return vec;
+}
+
+/* python objects */
+
+typedef struct {
+  PyObject_HEAD
+  LDA *lda;
+} PyLDAObject;
+
+static void
+PyLDA_dealloc(PyLDAObject *self) {
+  delete self->lda;
+  Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+static PyObject *
+PyLDA_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+  PyLDAObject *self = reinterpret_cast<PyLDAObject*>(type->tp_alloc(type, 0));
+  if(self != NULL) {
+    self->lda = NULL;
+  }
+  return reinterpret_cast<PyObject*>(self);
+}
+
+// check CSR arrays and give them to set_data(), which copies the documents; arrays are
+// read without copying if they are already contiguous int32 arrays, and others (e.g.
+// int64 of NumPy by default) are cast to temporary copies
+static int
+check_corpus(PyLDAObject *self, PyArrayObject *corpus[3]) {
+  int num_docs = PyArray_SIZE(corpus[0]) - 1;
+  if(num_docs < 0) {
+    PyErr_SetString(PyExc_ValueError, "indptr must have at least one element");
+    return -1;
+  }
+  const int *ptr = static_cast<const int*>(PyArray_DATA(corpus[0]));
+  const int *ids = static_cast<const int*>(PyArray_DATA(corpus[1]));
+  const int *freqs = static_cast<const int*>(PyArray_DATA(corpus[2]));
+  if(PyArray_SIZE(corpus[1]) < ptr[num_docs] || PyArray_SIZE(corpus[2]) < ptr[num_docs]) {
+    PyErr_SetString(PyExc_ValueError, "indices and freqs must have indptr[-1] elements");
+    return -1;
+  }
+  for(int d = 0; d < num_docs; ++d) {
+    if(ptr[d] < 0 || ptr[d] > ptr[d+1]) {
+      PyErr_SetString(PyExc_ValueError, "indptr must be non-decreasing from 0");
+      return -1;
+    }
+  }
+  for(int j = 0; j < ptr[num_docs]; ++j) {
+    if(ids[j] < 0 || freqs[j] < 0) {
+      PyErr_SetString(PyExc_ValueError, "indices and freqs must be non-negative");
+      return -1;
+    }
+  }
+  self->lda->set_data(num_docs, ptr, ids, freqs);
+  return 0;
+}
+
+static int
+set_corpus(PyLDAObject *self, PyObject *indptr, PyObject *indices, PyObject *freqs) {
+  PyObject *objs[3] = {indptr, indices, freqs};
+  PyArrayObject *corpus[3] = {NULL, NULL, NULL};
+  int result = -1;
+  for(int i = 0; i < 3; ++i) {
+    corpus[i] = reinterpret_cast<PyArrayObject*>(PyArray_FROMANY(objs[i], NPY_INT32, 1, 1, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST));
+    if(corpus[i] == NULL) break;
+  }
+  if(corpus[2] != NULL) {
+    result = check_corpus(self, corpus);
+  }
+  for(int i = 0; i < 3; ++i) {
+    Py_XDECREF(corpus[i]);
+  }
+  return result;
+}
+
+static int
+PyLDA_init_common(PyLDAObject *self, PyObject *args, PyObject *kwds, bool with_dnf) {
+  static const char *kwlist[] = {"indptr", "indices", "freqs", "num_topics", "alpha", "beta",
+                                 "max_steps", "num_loops", "burn_in", "converge", "seed", "verbose", "out_base",
+                                 "dnf", "eta", NULL};
+  static const char *kwlist_lda[] = {"indptr", "indices", "freqs", "num_topics", "alpha", "beta",
+                                     "max_steps", "num_loops", "burn_in", "converge", "seed", "verbose", "out_base",
+                                     NULL};
+  PyObject *indptr, *indices, *freqs;
+  int num_topics = 10;
+  double alpha = 1.0;
+  double beta = 0.01;
+  int max_steps = 10;
+  int num_loops = 10;
+  int burn_in = 5;
+  int converge = 0;
+  int seed = 0;
+  int verbose = 0;
+  const char *out_base = "";
+  PyObject *dnf = NULL;
+  double eta = 10;
+  const char *format = with_dnf ? "OOO|iddiiipipsOd" : "OOO|iddiiipips";
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, format, const_cast<char**>(with_dnf ? kwlist : kwlist_lda),
+                                  &indptr, &indices, &freqs, &num_topics, &alpha, &beta,
+                                  &max_steps, &num_loops, &burn_in, &converge, &seed, &verbose, &out_base,
+                                  &dnf, &eta)) {
+    return -1;
+  }
+  if(num_topics <= 0 || alpha <= 0 || beta <= 0 || max_steps <= 0) {
+    PyErr_SetString(PyExc_ValueError, "num_topics, alpha, beta and max_steps must be positive");
+    return -1;
+  }
+
+  vector<string> dnf_lines;
+  if(with_dnf && dnf != NULL) {
+    PyObject *seq = PySequence_Fast(dnf, "dnf must be a sequence of str");
+    if(seq == NULL) return -1;
+    for(Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); ++i) {
+      const char *line = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(seq, i));
+      if(line == NULL) {
+        Py_DECREF(seq);
+        return -1;
+      }
+      dnf_lines.push_back(line);
+    }
+    Py_DECREF(seq);
+  }
+  if(with_dnf && dnf_lines.size() == 0) {
+    PyErr_SetString(PyExc_ValueError, "dnf must include at least one line");
+    return -1;
+  }
+
+  delete self->lda;
+  // no data/dnf files, which are given by set_data()/set_dnf()
+  self->lda = create_lda("", out_base, num_topics, alpha, beta,
+                         max_steps, num_loops, burn_in, converge, seed, verbose,
+                         with_dnf ? "<dnf>" : "", eta);
+  try {
+    if(with_dnf) {
+      LDABinding::set_dnf(dynamic_cast<LDADF*>(self->lda), dnf_lines);
+    }
+  } catch(const exception &e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return -1;
+  }
+  return set_corpus(self, indptr, indices, freqs);
+}
+
+static int
+PyLDA_init(PyLDAObject *self, PyObject *args, PyObject *kwds) {
+  return PyLDA_init_common(self, args, kwds, false);
+}
+
+static int
+PyLDADF_init(PyLDAObject *self, PyObject *args, PyObject *kwds) {
+  return PyLDA_init_common(self, args, kwds, true);
+}
+
+// the model is created by __init__(), which a subclass may not call
+static bool
+check_created(PyLDAObject *self) {
+  if(self->lda == NULL) {
+    PyErr_SetString(PyExc_RuntimeError, "model is not created (missing __init__() call)");
+    return false;
+  }
+  return true;
+}
+
+// call a training method without GIL, reporting C++ errors as RuntimeError
+static PyObject *
+call_method(PyLDAObject *self, void (LDA::*method)()) {
+  if(!check_created(self)) return NULL;
+  string error;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    (self->lda->*method)();
+  } catch(const exception &e) {
+    error = e.what();
+  }
+  Py_END_ALLOW_THREADS
+  if(error != "") {
+    PyErr_SetString(PyExc_RuntimeError, error.c_str());
+    return NULL;
+  }
+  Py_RETURN_NONE;
+}
+
+static bool
+check_initialized(PyLDAObject *self) {
+  if(!check_created(self)) return false;
+  if(!LDABinding::is_initialized(self->lda)) {
+    PyErr_SetString(PyExc_RuntimeError, "call run() or initialize() first");
+    return false;
+  }
+  return true;
+}
+
+static PyObject *
+PyLDA_run(PyLDAObject *self, PyObject *Py_UNUSED(args)) {
+  return call_method(self, &LDA::run);
+}
+
+static PyObject *
+PyLDA_initialize(PyLDAObject *self, PyObject *Py_UNUSED(args)) {
+  return call_method(self, &LDA::initialize);
+}
+
+static PyObject *
+PyLDA_preprocess(PyLDAObject *self, PyObject *Py_UNUSED(args)) {
+  if(!check_initialized(self)) return NULL;
+  return call_method(self, &LDA::preprocess);
+}
+
+static PyObject *
+PyLDA_infer(PyLDAObject *self, PyObject *Py_UNUSED(args)) {
+  if(!check_initialized(self)) return NULL;
+  return call_method(self, &LDA::infer);
+}
+
+static PyObject *
+PyLDA_phi(PyLDAObject *self, PyObject *Py_UNUSED(args)) {
+  if(!check_initialized(self)) return NULL;
+  return LDABinding::phi(self->lda);
+}
+
+static PyObject *
+PyLDA_theta(PyLDAObject *self, PyObject *Py_UNUSED(args)) {
+  if(!check_initialized(self)) return NULL;
+  return LDABinding::theta(self->lda);
+}
+
+static PyObject *
+PyLDA_cwz(PyLDAObject *self, PyObject *Py_UNUSED(args)) {
+  if(!check_initialized(self)) return NULL;
+  return LDABinding::cwz(self->lda);
+}
+
+static PyObject *
+PyLDA_cdz(PyLDAObject *self, PyObject *Py_UNUSED(args)) {
+  if(!check_initialized(self)) return NULL;
+  return LDABinding::cdz(self->lda);
+}
+
+static PyObject *
+PyLDA_dz(PyLDAObject *self, PyObject *Py_UNUSED(args)) {
+  if(!check_initialized(self)) return NULL;
+  return LDABinding::dz(self->lda);
+}
+
+static PyObject *
+PyLDA_perplexity(PyLDAObject *self, PyObject *Py_UNUSED(args)) {
+  if(!check_initialized(self)) return NULL;
+  return PyFloat_FromDouble(LDABinding::perplexity(self->lda));
+}
+
+static PyObject *
+PyLDA_save(PyLDAObject *self, PyObject *args) {
+  const char *out_base;
+  if(!PyArg_ParseTuple(args, "s", &out_base)) return NULL;
+  if(!check_initialized(self)) return NULL;
+  try {
+    LDABinding::save(self->lda, out_base);
+  } catch(const exception &e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return NULL;
+  }
+  Py_RETURN_NONE;
+}
+
+static PyMethodDef PyLDA_methods[] = {
+  {"run", (PyCFunction)PyLDA_run, METH_NOARGS, "initialize(), preprocess() and infer()"},
+  {"initialize", (PyCFunction)PyLDA_initialize, METH_NOARGS, "allocate counts for inference"},
+  {"preprocess", (PyCFunction)PyLDA_preprocess, METH_NOARGS, "assign initial topics"},
+  {"infer", (PyCFunction)PyLDA_infer, METH_NOARGS, "run gibbs sampling (without GIL)"},
+  {"phi", (PyCFunction)PyLDA_phi, METH_NOARGS, "topic-word distribution (num_topics x num_words)"},
+  {"theta", (PyCFunction)PyLDA_theta, METH_NOARGS, "document-topic distribution (num_docs x num_topics)"},
+  {"cwz", (PyCFunction)PyLDA_cwz, METH_NOARGS, "word-topic counts (num_words x num_topics)"},
+  {"cdz", (PyCFunction)PyLDA_cdz, METH_NOARGS, "document-topic counts (num_docs x num_topics)"},
+  {"dz", (PyCFunction)PyLDA_dz, METH_NOARGS, "index of dtree assigned for each topic (LDADF only)"},
+  {"perplexity", (PyCFunction)PyLDA_perplexity, METH_NOARGS, "training-set perplexity"},
+  {"save", (PyCFunction)PyLDA_save, METH_VARARGS, "save .phi/.theta/.smp(/.dti) files with a given prefix"},
+  {NULL}
+};
+
+static PyTypeObject PyLDAType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+};
+
+static PyTypeObject PyLDADFType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+};
+
+static PyModuleDef pyldadf_module = {
+  PyModuleDef_HEAD_INIT,
+  "pyldadf",
+  "LDA with logical constraints on words",
+  -1,
+  NULL
+};
+
+PyMODINIT_FUNC
+PyInit_pyldadf(void) {
+  import_array();
+
+  PyLDAType.tp_name = "pyldadf.LDA";
+  PyLDAType.tp_doc = "LDA(indptr, indices, freqs, num_topics=10, alpha=1.0, beta=0.01, max_steps=10, num_loops=10, "
+    "burn_in=5, converge=False, seed=0, verbose=False, out_base='')";
+  PyLDAType.tp_basicsize = sizeof(PyLDAObject);
+  PyLDAType.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE;
+  PyLDAType.tp_new = PyLDA_new;
+  PyLDAType.tp_init = (initproc)PyLDA_init;
+  PyLDAType.tp_dealloc = (destructor)PyLDA_dealloc;
+  PyLDAType.tp_methods = PyLDA_methods;
+  if(PyType_Ready(&PyLDAType) < 0) return NULL;
+
+  PyLDADFType.tp_name = "pyldadf.LDADF";
+  PyLDADFType.tp_doc = "LDADF(indptr, indices, freqs, ..., dnf=[lines of .dnf], eta=10)";
+  PyLDADFType.tp_basicsize = sizeof(PyLDAObject);
+  PyLDADFType.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE;
+  PyLDADFType.tp_base = &PyLDAType;
+  PyLDADFType.tp_init = (initproc)PyLDADF_init;
+  if(PyType_Ready(&PyLDADFType) < 0) return NULL;
+
+  PyObject *m = PyModule_Create(&pyldadf_module);
+  if(m == NULL) return NULL;
+  Py_INCREF(&PyLDAType);
+  Py_INCREF(&PyLDADFType);
+  if(PyModule_AddObject(m, "LDA", reinterpret_cast<PyObject*>(&PyLDAType)) < 0 ||
+     PyModule_AddObject(m, "LDADF", reinterpret_cast<PyObject*>(&PyLDADFType)) < 0) {
+    Py_DECREF(&PyLDAType);
+    Py_DECREF(&PyLDADFType);
+    Py_DECREF(m);
+    return NULL;
+  }
+  return m;
+}
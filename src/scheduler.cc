@@ -0,0 +1,101 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include <thread>
+using namespace std;
+
+#include "utils.h"
+using namespace ldautils;
+
+TaskScheduler::TaskScheduler(const vector<long> &weights_, int num_threads_)
+  : weights(weights_),
+    num_threads(num_threads_),
+    queues(num_threads_),
+    locks(num_threads_),
+    busy(num_threads_, 0.0),
+    elapsed(0.0),
+    num_steals(0) {
+  assert(num_threads > 0);
+}
+
+void
+TaskScheduler::partition() {
+  // longest processing time first, so that each queue is in descending weights
+  int num_tasks = weights.size();
+  vector<int> order(num_tasks);
+  for(int k = 0; k < num_tasks; ++k) {
+    order[k] = k;
+  }
+  stable_sort(order.begin(), order.end(), [&](int a, int b) { return weights[a] > weights[b]; });
+
+  vector<long> loads(num_threads, 0);
+  for(int t = 0; t < num_threads; ++t) {
+    queues[t].clear();
+  }
+  for(int k = 0; k < num_tasks; ++k) {
+    int t = min_element(loads.begin(), loads.end()) - loads.begin();
+    queues[t].push_back(order[k]);
+    loads[t] += weights[order[k]];
+  }
+}
+
+bool
+TaskScheduler::next_task(int thread, int &task) {
+  {
+    lock_guard<mutex> lock(locks[thread]);
+    if(!queues[thread].empty()) {
+      task = queues[thread].front();
+      queues[thread].pop_front();
+      return true;
+    }
+  }
+  for(int i = 1; i < num_threads; ++i) {
+    int t = (thread + i) % num_threads;
+    lock_guard<mutex> lock(locks[t]);
+    if(!queues[t].empty()) {
+      task = queues[t].back();
+      queues[t].pop_back();
+      ++num_steals;
+      return true;
+    }
+  }
+  return false; // no task is added while running, so all queues are empty
+}
+
+void
+TaskScheduler::run(const function<void(int, int)> &func, const function<void(int)> &init) {
+  partition();
+  num_steals = 0;
+  double start = get_time();
+  auto worker = [&](int t) {
+    double busy_start = get_time();
+    if(init) init(t);
+    int task;
+    while(next_task(t, task)) {
+      func(t, task);
+    }
+    busy[t] = get_time() - busy_start;
+  };
+
+  vector<thread> threads;
+  for(int t = 1; t < num_threads; ++t) {
+    threads.push_back(thread(worker, t));
+  }
+  worker(0); // in the calling thread
+  for(size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  elapsed = get_time() - start;
+}
+
+double
+TaskScheduler::get_utilization() const {
+  if(elapsed <= 0.0) return 1.0;
+  double s = 0.0;
+  for(int t = 0; t < num_threads; ++t) {
+    s += busy[t];
+  }
+  return s / (num_threads * elapsed);
+}
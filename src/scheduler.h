@@ -0,0 +1,40 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// runs weighted tasks (e.g. token ranges) on threads: each thread first gets tasks
+// partitioned by weight (heaviest first to the least loaded thread), and a thread
+// with no task left steals the lightest one from the back of another queue
+class TaskScheduler {
+  friend class TestTaskScheduler;
+
+ public:
+  TaskScheduler(const std::vector<long> &weights, int num_threads);
+
+  // func(thread, task) for all tasks, after init(thread) in each thread if given
+  void run(const std::function<void(int, int)> &func,
+           const std::function<void(int)> &init = std::function<void(int)>());
+
+  double get_utilization() const; // busy time / (threads * elapsed time) of the last run()
+  int get_num_steals() const { return num_steals; }
+
+ protected:
+  void partition();
+  bool next_task(int thread, int &task);
+
+ protected:
+  std::vector<long> weights;
+  int num_threads;
+  std::vector<std::deque<int> > queues; // queues[t] = tasks of thread t
+  std::vector<std::mutex> locks; // locks[t] = lock of queues[t]
+  std::vector<double> busy; // busy[t] = seconds of thread t running tasks
+  double elapsed;
+  std::atomic<int> num_steals;
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdio>
+#include <vector>
+using namespace std;
+
+#include "../chains.h"
+#include "../ldak.h"
+#include "../utils.h"
+using namespace ldautils;
+
+class TestLDAChains : public CxxTest::TestSuite {
+  string dat_file;
+  string dnf_file;
+  string out_base;
+  vector<LDA*> ldas;
+
+ public:
+
+  void setUp() {
+    dat_file = "../data/test.dat";
+    dnf_file = "../data/test.dnf";
+    out_base = "./test.tmp";
+  }
+
+  void tearDown() {
+    for(size_t c = 0; c < ldas.size(); ++c) {
+      delete ldas[c];
+    }
+    ldas.clear();
+    remove((out_base + ".chains").c_str());
+    remove((out_base + ".final.phi").c_str());
+    remove((out_base + ".final.theta").c_str());
+    remove((out_base + ".final.smp").c_str());
+    remove((out_base + ".final.dti").c_str());
+  }
+
+  void make_chains(int num_chains, int max_steps, bool converge, string dnf) {
+    for(int c = 0; c < num_chains; ++c) {
+      ldas.push_back(create_lda(c == 0 ? dat_file : "", out_base, 2, 0.1, 0.1,
+                                max_steps, 0, 2, converge, c, false, dnf, 10));
+    }
+  }
+
+  void test_initialize() {
+    make_chains(3, 5, false, "");
+    LDAChains chains(ldas);
+    chains.initialize();
+    for(int c = 1; c < 3; ++c) {
+      TS_ASSERT_EQUALS(ldas[c]->docs.get(), ldas[0]->docs.get()); // shared
+      TS_ASSERT_EQUALS(ldas[c]->num_terms, ldas[0]->num_terms);
+      TS_ASSERT_EQUALS(ldas[c]->cwz.size(), ldas[0]->cwz.size());
+    }
+  }
+
+  void test_run() {
+    make_chains(3, 5, false, dnf_file);
+    LDAChains chains(ldas);
+    chains.run();
+    TS_ASSERT_EQUALS(chains.num_steps, 5);
+    TS_ASSERT_EQUALS(chains.lls[0].size(), 3); // after burn-in
+    for(int c = 0; c < 3; ++c) {
+      TS_ASSERT(chains.pps[c] > 0.0);
+      TS_ASSERT_EQUALS(sum(ldas[c]->cz), ldas[c]->num_terms);
+    }
+    ifstream in((out_base + ".chains").c_str());
+    TS_ASSERT(in.is_open());
+  }
+
+  void test_converge() {
+    make_chains(2, 1000, true, "");
+    LDAChains chains(ldas, 1.5);
+    chains.run();
+    TS_ASSERT(chains.num_steps < 1000);
+    TS_ASSERT(chains.rhats.back() < 1.5);
+  }
+};
@@ -0,0 +1,89 @@
+#include <cxxtest/TestSuite.h>
+
+#include <vector>
+using namespace std;
+
+#include "../counts.h"
+
+class TestCountMatrix : public CxxTest::TestSuite {
+ public:
+
+  void test_assign() {
+    CountMatrix wide, compact;
+    wide.assign(3, 4);
+    compact.assign(3, 4, true);
+    TS_ASSERT_EQUALS(wide.size(), 3);
+    TS_ASSERT_EQUALS(wide.cols(), 4);
+    TS_ASSERT(!wide.is_compact());
+    TS_ASSERT(compact.is_compact());
+    TS_ASSERT_EQUALS(compact.num_promoted(), 0);
+    TS_ASSERT(compact.bytes() < wide.bytes());
+    for(int r = 0; r < 3; ++r) {
+      for(int c = 0; c < 4; ++c) {
+        TS_ASSERT_EQUALS(wide.get(r, c), 0);
+        TS_ASSERT_EQUALS(compact.get(r, c), 0);
+      }
+    }
+  }
+
+  void test_inc_dec() {
+    CountMatrix counts;
+    counts.assign(2, 3, true);
+    counts.inc(1, 2);
+    counts.inc(1, 2);
+    counts.inc(0, 1);
+    counts.dec(1, 2);
+    TS_ASSERT_EQUALS(counts.get(1, 2), 1);
+    TS_ASSERT_EQUALS(counts.get(0, 1), 1);
+    TS_ASSERT_EQUALS(counts.row_sum(1), 1);
+
+    vector<vector<int> > mat;
+    counts.to_vector(mat);
+    int true_mat[2][3] = {{0, 1, 0}, {0, 0, 1}};
+    for(int r = 0; r < 2; ++r) {
+      for(int c = 0; c < 3; ++c) {
+        TS_ASSERT_EQUALS(mat[r][c], true_mat[r][c]);
+      }
+    }
+  }
+
+  void test_promote() {
+    CountMatrix counts;
+    counts.assign(3, 2, true);
+    counts.set(0, 0, 7);
+    counts.set(1, 1, 65535);
+    counts.set(2, 0, 5);
+    TS_ASSERT_EQUALS(counts.num_promoted(), 0);
+
+    // overflow by inc() promotes only the row
+    counts.inc(1, 1);
+    TS_ASSERT(counts.is_promoted(1));
+    TS_ASSERT(!counts.is_promoted(0));
+    TS_ASSERT_EQUALS(counts.num_promoted(), 1);
+    TS_ASSERT_EQUALS(counts.get(1, 1), 65536);
+    counts.dec(1, 1);
+    counts.dec(1, 1);
+    TS_ASSERT_EQUALS(counts.get(1, 1), 65534);
+
+    // overflow by set()
+    counts.set(2, 1, 100000);
+    TS_ASSERT(counts.is_promoted(2));
+    TS_ASSERT_EQUALS(counts.get(2, 0), 5);
+    TS_ASSERT_EQUALS(counts.get(2, 1), 100000);
+    TS_ASSERT_EQUALS(counts.get(0, 0), 7);
+  }
+
+  void test_row() {
+    CountMatrix counts;
+    counts.assign(2, 3, true);
+    counts.set(0, 2, 3);
+    counts.set(1, 0, 70000);
+    int buf[3];
+    const int *row = counts.row(0, buf);
+    TS_ASSERT(row == buf); // widened
+    TS_ASSERT_EQUALS(row[2], 3);
+    row = counts.row(1, buf);
+    TS_ASSERT(row != buf); // promoted
+    TS_ASSERT_EQUALS(row[0], 70000);
+  }
+};
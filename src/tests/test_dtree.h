@@ -44,6 +44,9 @@ public:
     TS_ASSERT_EQUALS(dt.np[0], 0);
     TS_ASSERT_EQUALS(dt.np[1], 1);
     TS_ASSERT_EQUALS(dt.np[2], 2);
+
+    TS_ASSERT_THROWS(dt.parse("0,1"), runtime_error);
+    TS_ASSERT_THROWS(dt.parse("0;1;2"), runtime_error);
   }
 
   void test_str() {
@@ -59,4 +62,17 @@ public:
     dt.parse(";0,1,2");
     TS_ASSERT_EQUALS(dt.str(), "Np(0,1,2)");
   }
+
+  void test_remap() {
+    int index_[] = {-1, 0, 1, -1, 2, -1, 3};
+    std::vector<int> index(index_, index_ + 7);
+    dt.parse("0,1:3,5;4,6,9");
+    dt.remap(index);
+    TS_ASSERT_EQUALS(dt.str(), "Ep(0)^Np(2,3)"); // Ep(3,5) and 9 are dropped
+    TS_ASSERT_EQUALS(dt.get_type(0), DTree::Ep);
+    TS_ASSERT_EQUALS(dt.get_ep(0), 0);
+    TS_ASSERT_EQUALS(dt.get_type(1), DTree::None);
+    TS_ASSERT_EQUALS(dt.get_type(2), DTree::Np);
+    TS_ASSERT_EQUALS(dt.get_type(3), DTree::Np);
+  }
 };
@@ -0,0 +1,90 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+using namespace std;
+
+#include "../grid.h"
+#include "../ldak.h"
+#include "../utils.h"
+using namespace ldautils;
+
+class TestLDAGrid : public CxxTest::TestSuite {
+  string dat_file;
+  string dnf_file;
+  string out_base;
+  vector<LDA*> ldas;
+
+ public:
+
+  void setUp() {
+    dat_file = "../data/test.dat";
+    dnf_file = "../data/test.dnf";
+    out_base = "./test.tmp";
+  }
+
+  void tearDown() {
+    for(size_t k = 0; k < ldas.size(); ++k) {
+      remove((ldas[k]->out_base + ".final.phi").c_str());
+      remove((ldas[k]->out_base + ".final.theta").c_str());
+      remove((ldas[k]->out_base + ".final.smp").c_str());
+      remove((ldas[k]->out_base + ".final.dti").c_str());
+      delete ldas[k];
+    }
+    ldas.clear();
+    remove((out_base + ".grid").c_str());
+  }
+
+  void make_grid(const vector<int> &topics, const vector<double> &alphas, string dnf) {
+    for(size_t i = 0; i < topics.size(); ++i) {
+      for(size_t j = 0; j < alphas.size(); ++j) {
+        int k = ldas.size();
+        ldas.push_back(create_lda(k == 0 ? dat_file : "", out_base + "." + str(k), topics[i], alphas[j], 0.1,
+                                  5, 0, 2, false, k, false, dnf, 10));
+      }
+    }
+  }
+
+  void test_run() {
+    make_grid({2, 3}, {0.1, 1.0}, dnf_file);
+    LDAGrid grid(ldas, 2, out_base + ".grid");
+    grid.run();
+    LDADF *first = dynamic_cast<LDADF*>(ldas[0]);
+    for(int k = 0; k < 4; ++k) {
+      TS_ASSERT_EQUALS(ldas[k]->docs.get(), ldas[0]->docs.get()); // shared
+      TS_ASSERT(grid.pps[k] > 0.0);
+      TS_ASSERT(grid.seconds[k] >= 0.0);
+      TS_ASSERT_EQUALS(sum(ldas[k]->cz), ldas[k]->num_terms);
+      LDADF *ldadf = dynamic_cast<LDADF*>(ldas[k]);
+      TS_ASSERT_EQUALS(ldadf->dtrees.get(), first->dtrees.get()); // parsed once, and shared
+      ifstream phi((ldas[k]->out_base + ".final.phi").c_str());
+      TS_ASSERT(phi.is_open());
+    }
+    TS_ASSERT_EQUALS(ldas[2]->num_topics, 3);
+    TS_ASSERT_EQUALS(ldas[1]->alpha, 1.0);
+
+    ifstream in((out_base + ".grid").c_str());
+    TS_ASSERT(in.is_open());
+    vector<string> lines;
+    string line;
+    while(getline(in, line)) {
+      lines.push_back(line);
+    }
+    TS_ASSERT_EQUALS(lines.size(), 6); // header, 4 configurations, best
+    TS_ASSERT_EQUALS(lines[0].substr(0, 6), "config");
+    TS_ASSERT_EQUALS(lines[3].substr(0, 4), "2\t3\t");
+    TS_ASSERT_EQUALS(lines[5].substr(0, 5), "best\t");
+  }
+
+  void test_run_lda() {
+    make_grid({2}, {0.1, 1.0}, "");
+    LDAGrid grid(ldas, 4); // more threads than configurations
+    grid.run();
+    for(int k = 0; k < 2; ++k) {
+      TS_ASSERT(grid.pps[k] > 0.0);
+    }
+    ifstream in((out_base + ".grid").c_str());
+    TS_ASSERT(!in.is_open()); // no summary
+  }
+};
@@ -0,0 +1,109 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+using namespace std;
+
+#include "../heldout.h"
+#include "../ldak.h"
+#include "../utils.h"
+using namespace ldautils;
+
+class TestLDAHeldout : public CxxTest::TestSuite {
+  string dat_file;
+  string dnf_file;
+  string out_base;
+
+ public:
+
+  void setUp() {
+    dat_file = "../data/test.dat";
+    dnf_file = "../data/test.dnf";
+    out_base = "./test.tmp";
+  }
+
+  void tearDown() {
+    remove((out_base + ".phi").c_str());
+    remove((out_base + ".dat").c_str());
+    remove((out_base + ".heldout").c_str());
+  }
+
+  void write_file(const string &file, const string &text) {
+    ofstream out(file.c_str());
+    out << text;
+  }
+
+  void test_one_topic() {
+    // p(w_i | w_<i) = phi[0][w_i] by both methods, skipping words without probability
+    write_file(out_base + ".phi", "0.5\n0.25\n0.25\n0\n"); // dense: a row per word
+    write_file(out_base + ".dat", "0:2 1:1 3:1\n4:1\n");
+    LDAHeldout heldout(out_base, 0.1, 3);
+    TS_ASSERT_EQUALS(heldout.num_topics, 1);
+    TS_ASSERT_EQUALS(heldout.num_words, 4);
+    heldout.load_data(out_base + ".dat");
+    TS_ASSERT_EQUALS(heldout.docs.size(), 2);
+    TS_ASSERT_EQUALS(heldout.docs[0].size(), 3);
+    TS_ASSERT_EQUALS(heldout.num_unknown, 2);
+
+    double pp = heldout.run();
+    TS_ASSERT_DELTA(heldout.log_liks[0], 2 * log(0.5) + log(0.25), 1e-9);
+    TS_ASSERT_EQUALS(heldout.num_heldout[0], 3);
+    TS_ASSERT_EQUALS(heldout.num_heldout[1], 0);
+    TS_ASSERT_DELTA(pp, exp(-(2 * log(0.5) + log(0.25)) / 3), 1e-9);
+
+    heldout.set_completion(true); // [0, 0, 1] shuffled, where the last term is held out
+    heldout.run();
+    double lik = heldout.log_liks[0];
+    TS_ASSERT(fabs(lik - log(0.5)) < 1e-9 || fabs(lik - log(0.25)) < 1e-9);
+    TS_ASSERT_EQUALS(heldout.num_heldout[0], 1);
+
+    heldout.save_results(out_base + ".heldout");
+    ifstream in((out_base + ".heldout").c_str());
+    TS_ASSERT(in.is_open());
+
+    write_file(out_base + ".dat", "0:2 1\n");
+    TS_ASSERT_THROWS(heldout.load_data(out_base + ".dat"), runtime_error);
+  }
+
+  void test_sparse_phi() {
+    write_file(out_base + ".phi", "0:0.5 1:0.5\n2:1\n"); // sparse: a row per topic
+    LDAHeldout heldout(out_base, 0.1);
+    TS_ASSERT_EQUALS(heldout.num_topics, 2);
+    TS_ASSERT_EQUALS(heldout.num_words, 3);
+    TS_ASSERT_EQUALS(heldout.phi_wz[2 * 2 + 1], 1.0);
+    TS_ASSERT_EQUALS(heldout.phi_wz[1 * 2 + 0], 0.5);
+  }
+
+  void test_model() {
+    LDA *lda = create_lda(dat_file, out_base, 2, 0.1, 0.1, 5, 0, 2, false, 0, false, dnf_file, 10);
+    lda->initialize();
+    lda->preprocess();
+    lda->infer();
+    vector<vector<double> > phi(2, vector<double>(lda->num_words));
+    lda->get_mean_phi(phi);
+
+    LDAHeldout heldout(*lda, 5, 0);
+    TS_ASSERT_EQUALS(heldout.num_topics, 2);
+    for(int w = 0; w < lda->num_words; ++w) {
+      TS_ASSERT_EQUALS(heldout.phi_wz[w * 2 + 1], phi[1][w]); // fixed LDA-DF weights
+    }
+    heldout.load_data(dat_file);
+    double pp = heldout.run();
+    TS_ASSERT(pp > 0.0);
+    TS_ASSERT(pp < lda->num_words);
+
+    // independent of threads
+    vector<double> log_liks = heldout.log_liks;
+    heldout.set_threads(3);
+    TS_ASSERT_EQUALS(heldout.run(), pp);
+    TS_ASSERT(heldout.log_liks == log_liks);
+    delete lda;
+    remove((out_base + ".final.phi").c_str());
+    remove((out_base + ".final.theta").c_str());
+    remove((out_base + ".final.smp").c_str());
+    remove((out_base + ".final.dti").c_str());
+  }
+};
@@ -1,5 +1,7 @@
 #include <cxxtest/TestSuite.h>
 
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 using namespace std;
 
@@ -24,6 +26,33 @@ class TestLDA : public CxxTest::TestSuite {
 
   void tearDown() {
   }
+
+  // counts of the model are consistent with the sampled topics hz
+  void check_counts(const LDA &lda) {
+    vector<vector<int> > cdz(lda.num_docs, vector<int>(lda.num_topics, 0));
+    vector<vector<int> > cwz(lda.num_words, vector<int>(lda.num_topics, 0));
+    vector<int> cz(lda.num_topics, 0);
+    for(int d = 0; d < lda.num_docs; ++d) {
+      for(int i = 0; i < lda.nd[d]; ++i) {
+        ++cdz[d][lda.hz[d][i]];
+        ++cwz[(*lda.docs)[d][i]][lda.hz[d][i]];
+        ++cz[lda.hz[d][i]];
+      }
+    }
+    vector<vector<int> > lda_cdz, lda_cwz;
+    lda.cdz.to_vector(lda_cdz);
+    lda.cwz.to_vector(lda_cwz);
+    TS_ASSERT(cdz == lda_cdz);
+    TS_ASSERT(cwz == lda_cwz);
+    TS_ASSERT(cz == lda.cz);
+  }
+
+  void remove_outputs(const string &base) {
+    const char *exts[] = {".phi", ".theta", ".smp", ".hz"};
+    for(int i = 0; i < 4; ++i) {
+      remove((base + exts[i]).c_str());
+    }
+  }
   
   void test_initialize() {
     lda.load_data(lda.data_file);
@@ -36,17 +65,17 @@ class TestLDA : public CxxTest::TestSuite {
 
     TS_ASSERT_EQUALS(lda.cdz.size(), lda.num_docs);
     for(int d = 0; d < lda.num_docs; ++d) {
-      TS_ASSERT_EQUALS(lda.cdz[d].size(), lda.num_topics);
+      TS_ASSERT_EQUALS(lda.cdz.cols(), lda.num_topics);
       for(int z = 0; z < lda.num_topics; ++z) {
-        TS_ASSERT_EQUALS(lda.cdz[d][z], 0);
+        TS_ASSERT_EQUALS(lda.cdz.get(d, z), 0);
       }
     }
 
     TS_ASSERT_EQUALS(lda.cwz.size(), lda.num_words);
     for(int w = 0; w < lda.num_words; ++w) {
-      TS_ASSERT_EQUALS(lda.cwz[w].size(), lda.num_topics);
+      TS_ASSERT_EQUALS(lda.cwz.cols(), lda.num_topics);
       for(int z = 0; z < lda.num_topics; ++z) {
-        TS_ASSERT_EQUALS(lda.cwz[w][z], 0);
+        TS_ASSERT_EQUALS(lda.cwz.get(w, z), 0);
       }
     }
 
@@ -88,31 +117,31 @@ class TestLDA : public CxxTest::TestSuite {
 
     int sum_cdz = 0;
     for(int d = 0; d < lda.num_docs; ++d) {
-      TS_ASSERT_EQUALS(sum(lda.cdz[d]), lda.nd.size());
-      sum_cdz += sum(lda.cdz[d]);
+      TS_ASSERT_EQUALS(lda.cdz.row_sum(d), lda.nd.size());
+      sum_cdz += lda.cdz.row_sum(d);
     }
     TS_ASSERT_EQUALS(sum_cdz, lda.num_terms);
 
     int sum_cwz = 0;
     for(int w = 0; w < lda.num_words; ++w) {
-      sum_cwz += sum(lda.cwz[w]);
+      sum_cwz += lda.cwz.row_sum(w);
     }
     TS_ASSERT_EQUALS(sum_cwz, lda.num_terms);
   }
 
   void test_load_data() {
     lda.load_data(lda.data_file);
-    TS_ASSERT_EQUALS(lda.docs.size(), 4);
-    TS_ASSERT_EQUALS(lda.docs[0].size(), 4);
-    TS_ASSERT_EQUALS(lda.docs[1].size(), 4);
-    TS_ASSERT_EQUALS(lda.docs[0][0], 0);
-    TS_ASSERT_EQUALS(lda.docs[0][1], 0);
-    TS_ASSERT_EQUALS(lda.docs[0][2], 1);
-    TS_ASSERT_EQUALS(lda.docs[0][3], 1);
-    TS_ASSERT_EQUALS(lda.docs[1][0], 0);
-    TS_ASSERT_EQUALS(lda.docs[1][1], 0);
-    TS_ASSERT_EQUALS(lda.docs[1][2], 2);
-    TS_ASSERT_EQUALS(lda.docs[1][3], 2);
+    TS_ASSERT_EQUALS(lda.docs->size(), 4);
+    TS_ASSERT_EQUALS((*lda.docs)[0].size(), 4);
+    TS_ASSERT_EQUALS((*lda.docs)[1].size(), 4);
+    TS_ASSERT_EQUALS((*lda.docs)[0][0], 0);
+    TS_ASSERT_EQUALS((*lda.docs)[0][1], 0);
+    TS_ASSERT_EQUALS((*lda.docs)[0][2], 1);
+    TS_ASSERT_EQUALS((*lda.docs)[0][3], 1);
+    TS_ASSERT_EQUALS((*lda.docs)[1][0], 0);
+    TS_ASSERT_EQUALS((*lda.docs)[1][1], 0);
+    TS_ASSERT_EQUALS((*lda.docs)[1][2], 2);
+    TS_ASSERT_EQUALS((*lda.docs)[1][3], 2);
     
     TS_ASSERT_EQUALS(lda.num_docs, 4);
     TS_ASSERT_EQUALS(lda.num_words, 3);
@@ -131,13 +160,13 @@ class TestLDA : public CxxTest::TestSuite {
     lda.preprocess();
 
     int cz = lda.cz[0];
-    int cdz = lda.cdz[0][0];
-    int cwz = lda.cwz[0][0];
+    int cdz = lda.cdz.get(0, 0);
+    int cwz = lda.cwz.get(0, 0);
     lda.resample_pre(0, 0, 0);
 
     TS_ASSERT_EQUALS(lda.cz[0], cz - 1);
-    TS_ASSERT_EQUALS(lda.cdz[0][0], cdz - 1);
-    TS_ASSERT_EQUALS(lda.cwz[0][0], cwz - 1);
+    TS_ASSERT_EQUALS(lda.cdz.get(0, 0), cdz - 1);
+    TS_ASSERT_EQUALS(lda.cwz.get(0, 0), cwz - 1);
   }
 
   void test_resample_post() {
@@ -146,13 +175,188 @@ class TestLDA : public CxxTest::TestSuite {
     lda.preprocess();
 
     int cz = lda.cz[0];
-    int cdz = lda.cdz[0][0];
-    int cwz = lda.cwz[0][0];
+    int cdz = lda.cdz.get(0, 0);
+    int cwz = lda.cwz.get(0, 0);
     lda.resample_post(0, 0, 0);
 
     TS_ASSERT_EQUALS(lda.cz[0], cz + 1);
-    TS_ASSERT_EQUALS(lda.cdz[0][0], cdz + 1);
-    TS_ASSERT_EQUALS(lda.cwz[0][0], cwz + 1);
+    TS_ASSERT_EQUALS(lda.cdz.get(0, 0), cdz + 1);
+    TS_ASSERT_EQUALS(lda.cwz.get(0, 0), cwz + 1);
+  }
+
+  void test_resample_grouped() {
+    lda.initialize();
+    lda.preprocess();
+    lda.set_grouped(true);
+
+    // tokens of word 0 at the beginning of document 0 are drawn from one conditional,
+    // computed after both of them are removed
+    for(unsigned seed = 0; seed < 10; ++seed) {
+      LDA removed = lda;
+      for(int i = 0; i < 2; ++i) {
+        removed.resample_pre(0, 0, removed.hz[0][i]);
+      }
+      vector<double> cum(lda.num_topics);
+      removed.calc_weights(0, 0, cum);
+      set_seed(seed);
+      int z0 = multi_cum(&cum[0], lda.num_topics);
+      int z1 = multi_cum(&cum[0], lda.num_topics);
+      set_seed(seed);
+      lda.resample_group(0, 0, 2);
+      TS_ASSERT_EQUALS(lda.hz[0][0], z0);
+      TS_ASSERT_EQUALS(lda.hz[0][1], z1);
+    }
+
+    lda.resample();
+    check_counts(lda);
+  }
+
+  void test_resample_word_major() {
+    lda.set_word_major(true);
+    lda.initialize();
+
+    // tokens of each word in the order of documents, so that a run of the word
+    // in a document is adjacent for grouped sampling
+    int num_tokens = 0;
+    for(int w = 0; w < lda.num_words; ++w) {
+      for(size_t k = 0; k < lda.word_tokens[w].size(); ++k) {
+        int d = lda.word_tokens[w][k].first;
+        int i = lda.word_tokens[w][k].second;
+        TS_ASSERT_EQUALS((*lda.docs)[d][i], w);
+        if(k > 0) TS_ASSERT(lda.word_tokens[w][k-1] < lda.word_tokens[w][k]);
+        ++num_tokens;
+      }
+    }
+    TS_ASSERT_EQUALS(num_tokens, lda.num_terms);
+
+    lda.preprocess();
+    lda.set_grouped(true);
+    lda.resample();
+    check_counts(lda);
+    lda.set_grouped(false);
+    lda.resample();
+    check_counts(lda);
+  }
+
+  void test_resample_parallel() {
+    lda.set_threads(3, 3);
+    lda.initialize();
+    lda.preprocess();
+    for(int i = 0; i < 5; ++i) {
+      lda.resample();
+    }
+
+    // tasks cover all tokens once, splitting documents longer than a chunk
+    vector<vector<int> > covered(lda.num_docs);
+    for(int d = 0; d < lda.num_docs; ++d) {
+      covered[d].assign(lda.nd[d], 0);
+    }
+    for(size_t k = 0; k < lda.tasks.size(); ++k) {
+      for(size_t j = 0; j < lda.tasks[k].size(); ++j) {
+        const TokenRange &r = lda.tasks[k][j];
+        TS_ASSERT(r.end - r.begin <= 3);
+        for(int i = r.begin; i < r.end; ++i) {
+          ++covered[r.d][i];
+        }
+      }
+    }
+    for(int d = 0; d < lda.num_docs; ++d) {
+      TS_ASSERT(covered[d] == vector<int>(lda.nd[d], 1));
+    }
+    TS_ASSERT(lda.tasks.size() > (size_t)lda.num_docs);
+    TS_ASSERT_EQUALS(lda.workers.size(), 3);
+
+    // merged counts are consistent with samples
+    check_counts(lda);
+  }
+
+  void test_conditional_init() {
+    // serially, and in threads after documents of a share of tokens
+    vector<int> serial_hz;
+    for(int num_threads = 1; num_threads <= 2; ++num_threads) {
+      lda = LDA(lda.data_file, "", 2, 0.1, 0.1);
+      lda.set_conditional_init(true);
+      lda.set_threads(num_threads, 3);
+      lda.initialize();
+      lda.preprocess();
+      check_counts(lda);
+      TS_ASSERT_DELTA(lda.get_log_likelihood(), lda.calc_log_likelihood(), delta);
+      // the share (document 0 of 16 tokens) is sampled before threads as serially
+      if(num_threads == 1) serial_hz = lda.hz[0];
+      else TS_ASSERT(lda.hz[0] == serial_hz);
+    }
+  }
+
+  void test_log_likelihood() {
+    lda.load_data(lda.data_file);
+    lda.initialize();
+    lda.preprocess();
+    TS_ASSERT_DELTA(lda.get_log_likelihood(), lda.calc_log_likelihood(), delta);
+    for(int i = 0; i < 10; ++i) {
+      lda.resample();
+      TS_ASSERT_DELTA(lda.get_log_likelihood(), lda.calc_log_likelihood(), delta);
+    }
+    lda.set_grouped(true);
+    for(int i = 0; i < 10; ++i) {
+      lda.resample();
+      TS_ASSERT_DELTA(lda.get_log_likelihood(), lda.calc_log_likelihood(), delta);
+    }
+  }
+
+  void test_compact_counts() {
+    LDA compact = lda;
+    compact.set_compact_counts(true);
+    lda.load_data(lda.data_file);
+    lda.initialize();
+    lda.preprocess();
+    lda.resample();
+    compact.load_data(compact.data_file);
+    compact.initialize();
+    compact.preprocess();
+    compact.resample();
+
+    // same samples as int counts given the same seed
+    TS_ASSERT(compact.cwz.is_compact());
+    TS_ASSERT(compact.hz == lda.hz);
+    vector<vector<int> > cwz, compact_cwz;
+    lda.cwz.to_vector(cwz);
+    compact.cwz.to_vector(compact_cwz);
+    TS_ASSERT(cwz == compact_cwz);
+  }
+
+  void test_compact_words() {
+    string tmp_base = "./test.tmp";
+    // words 3 and 10 in 11 word ids
+    int indptr[] = {0, 2, 3};
+    int indices[] = {3, 10, 10};
+    int freqs[] = {2, 1, 1};
+    lda = LDA("", "", 2, 0.1, 0.1);
+    lda.set_compact_words(true);
+    lda.set_data(2, indptr, indices, freqs);
+    TS_ASSERT_EQUALS(lda.num_words, 2);
+    TS_ASSERT_EQUALS(lda.word_ids.size(), 2);
+    TS_ASSERT_EQUALS(lda.word_ids[0], 3);
+    TS_ASSERT_EQUALS(lda.word_ids[1], 10);
+    TS_ASSERT_EQUALS(lda.word_index[3], 0);
+    TS_ASSERT_EQUALS(lda.word_index[0], -1);
+    TS_ASSERT_EQUALS((*lda.docs)[0][0], 0);
+    TS_ASSERT_EQUALS((*lda.docs)[0][2], 1);
+    TS_ASSERT_EQUALS((*lda.docs)[1][0], 1);
+
+    // outputs in word ids of the data
+    lda.initialize();
+    lda.preprocess();
+    lda.resample();
+    lda.save_params(tmp_base);
+    vector<vector<double> > phi_t;
+    load_matrix(tmp_base + ".phi", phi_t);
+    TS_ASSERT_EQUALS(phi_t.size(), 11);
+    for(int id = 0; id < 11; ++id) {
+      double s = phi_t[id][0] + phi_t[id][1];
+      if(id == 3 || id == 10) TS_ASSERT(s > 0);
+      else TS_ASSERT_EQUALS(s, 0.0);
+    }
+    remove_outputs(tmp_base);
   }
 
   void test_calc_probs() {
@@ -161,8 +365,8 @@ class TestLDA : public CxxTest::TestSuite {
 
     // toy sample
     lda.cz[0] = lda.num_terms;
-    lda.cdz[0][0] = lda.num_terms;
-    lda.cwz[0][0] = lda.num_terms;
+    lda.cdz.set(0, 0, lda.num_terms);
+    lda.cwz.set(0, 0, lda.num_terms);
 
     lda.calc_probs(0, 0, lda.probs);
 
@@ -181,27 +385,90 @@ class TestLDA : public CxxTest::TestSuite {
     }
   }
 
+  void test_calc_weights() {
+    lda.load_data(lda.data_file);
+    lda.initialize();
+    lda.preprocess();
+
+    vector<double> probs(lda.num_topics);
+    vector<double> cum(lda.num_topics);
+    lda.calc_probs(0, 0, probs);
+    double s = lda.calc_weights(0, 0, cum);
+
+    TS_ASSERT_DELTA(cum[lda.num_topics-1], s, delta);
+    for(int z = 0; z < lda.num_topics; ++z) {
+      double prev = z > 0 ? cum[z-1] : 0.0;
+      TS_ASSERT_DELTA((cum[z] - prev) / s, probs[z], delta);
+    }
+  }
+
   void test_calc_perplexity() {
     lda.load_data(lda.data_file);
     lda.initialize();
 
     // toy sample
     lda.cz[0] = lda.num_terms;
-    lda.cdz[0][0] = lda.num_terms;
-    lda.cwz[0][0] = lda.num_terms;
+    lda.cdz.set(0, 0, lda.num_terms);
+    lda.cwz.set(0, 0, lda.num_terms);
 
     double pp = lda.calc_perplexity();
     TS_ASSERT_DELTA(pp, 4.15282, delta);
   }
 
+  void test_save_metrics() {
+    string tmp_file = "./test.tmp";
+    lda.load_data(lda.data_file);
+    lda.initialize();
+    lda.preprocess();
+    map<string, double> last_timings = lda.timings;
+    lda.resample();
+    TS_ASSERT(lda.num_changes >= 0);
+    TS_ASSERT(lda.num_changes <= lda.num_terms);
+
+    ofstream file(tmp_file.c_str());
+    lda.save_metrics(file, 3, 2.5, last_timings);
+    file.close();
+
+    string line;
+    ifstream in(tmp_file.c_str());
+    getline(in, line);
+    TS_ASSERT_EQUALS(line.find("{\"step\": 3, \"pp\": 2.5, \"time\": {"), 0);
+    TS_ASSERT(line.find("\"sample_topics\": ") != string::npos);
+    TS_ASSERT(line.find("\"change_rate\": ") != string::npos);
+    TS_ASSERT(line.find("\"peak_rss_kb\": ") != string::npos);
+    TS_ASSERT(!getline(in, line));
+  }
+
+  void test_time_budget() {
+    string tmp_file = "./test.tmp";
+    double budgets[] = {1e-9, 1000.0};
+    int true_steps[] = {1, 20}; // only the first step out of budget, or all steps
+    for(int k = 0; k < 2; ++k) {
+      lda = LDA(lda.data_file, "", 2, 0.1, 0.1, 20, 0, 5);
+      lda.out_base = ""; // no outputs
+      lda.set_metrics_file(tmp_file);
+      lda.set_time_budget(budgets[k]);
+      lda.initialize();
+      lda.preprocess();
+      lda.infer();
+
+      int num_steps = 0;
+      string line;
+      ifstream in(tmp_file.c_str());
+      while(getline(in, line)) ++num_steps;
+      TS_ASSERT_EQUALS(num_steps, true_steps[k]);
+    }
+    remove(tmp_file.c_str());
+  }
+
   void test_get_phi_theta() {
     lda.load_data(lda.data_file);
     lda.initialize();
 
     // toy sample
     lda.cz[0] = lda.num_terms;
-    lda.cdz[0][0] = lda.num_terms;
-    lda.cwz[0][0] = lda.num_terms;
+    lda.cdz.set(0, 0, lda.num_terms);
+    lda.cwz.set(0, 0, lda.num_terms);
 
     double alpha = lda.alpha;
     double beta = lda.alpha;
@@ -251,4 +518,186 @@ class TestLDA : public CxxTest::TestSuite {
       }
     }
   }
+
+  void test_accumulate_params() {
+    string tmp_base = "./test.tmp";
+    lda.set_average_every(1);
+    lda.load_data(lda.data_file);
+    lda.initialize();
+    lda.preprocess();
+
+    vector<vector<double> > phi_sum(lda.num_topics, vector<double>(lda.num_words, 0.0));
+    for(int i = 0; i < 3; ++i) {
+      lda.resample();
+      lda.accumulate_params();
+      for(int z = 0; z < lda.num_topics; ++z) {
+        for(int w = 0; w < lda.num_words; ++w) {
+          phi_sum[z][w] += lda.phi[z][w];
+        }
+      }
+    }
+    TS_ASSERT_EQUALS(lda.num_samples, 3);
+    for(int d = 0; d < lda.num_docs; ++d) {
+      TS_ASSERT_DELTA(sum(lda.theta_sum[d]), 3.0, delta);
+    }
+
+    // saved phi is the mean over samples
+    lda.save_params(tmp_base);
+    vector<vector<double> > phi_t;
+    load_matrix(tmp_base + ".phi", phi_t);
+    for(int z = 0; z < lda.num_topics; ++z) {
+      for(int w = 0; w < lda.num_words; ++w) {
+        TS_ASSERT_DELTA(phi_t[w][z], phi_sum[z][w] / 3, delta);
+      }
+    }
+    remove_outputs(tmp_base);
+  }
+
+  void test_warm_start() {
+    string tmp_base = "./test.tmp";
+    lda.load_data(lda.data_file);
+    lda.initialize();
+    lda.preprocess();
+    for(int i = 0; i < 20; ++i) {
+      lda.resample();
+    }
+    lda.set_sparse_output(1); // .smp keeps all counts
+    lda.save_params(tmp_base);
+
+    // data with a word (3) missing in the prior model
+    LDA warm("", "", 2, 0.1, 0.1);
+    int indptr[] = {0, 1, 3};
+    int indices[] = {1, 0, 3};
+    int freqs[] = {20, 2, 2};
+    warm.set_data(2, indptr, indices, freqs);
+    warm.set_warm_start(tmp_base);
+    warm.initialize();
+    vector<vector<double> > prior_cwz;
+    vector<double> prior_cz;
+    warm.load_prior(tmp_base, prior_cwz, prior_cz);
+    TS_ASSERT_EQUALS(prior_cwz.size(), 4);
+    for(int z = 0; z < 2; ++z) {
+      TS_ASSERT_EQUALS(prior_cwz[1][z], lda.cwz.get(1, z));
+      TS_ASSERT_EQUALS(prior_cwz[3][z], 0.0);
+      TS_ASSERT_EQUALS(prior_cz[z], lda.cz[z]);
+    }
+    warm.preprocess();
+    TS_ASSERT_EQUALS(sum(warm.cz), 24);
+    TS_ASSERT_EQUALS(warm.cdz.row_sum(1), 4);
+
+    // mostly the topic of word 1 in the prior model
+    int z1 = lda.cwz.get(1, 0) > lda.cwz.get(1, 1) ? 0 : 1;
+    TS_ASSERT(lda.cwz.get(1, 1 - z1) == 0);
+    TS_ASSERT(warm.cdz.get(0, z1) >= 18);
+    remove_outputs(tmp_base);
+  }
+
+  void test_resume() {
+    string tmp_base = "./test.tmp";
+    lda.set_save_state(true);
+    lda.load_data(lda.data_file);
+    lda.initialize();
+    lda.preprocess();
+    lda.resample();
+    lda.save_params(tmp_base);
+
+    // the same documents appended as new ones, and half of old ones swept in each step
+    LDA resumed(lda.data_file, "", 2, 0.1, 0.1);
+    resumed.set_resume(tmp_base, lda.data_file, 0.5);
+    resumed.initialize();
+    resumed.preprocess();
+    TS_ASSERT_EQUALS(resumed.num_docs, 2 * lda.num_docs);
+    TS_ASSERT_EQUALS(resumed.num_old_docs, lda.num_docs);
+    for(int d = 0; d < lda.num_docs; ++d) {
+      TS_ASSERT(resumed.hz[d] == lda.hz[d]);
+    }
+    TS_ASSERT_EQUALS(sum(resumed.cz), 2 * lda.num_terms);
+    TS_ASSERT_EQUALS(resumed.cdz.row_sum(lda.num_docs), lda.nd[0]);
+
+    for(int i = 0; i < 2; ++i) {
+      vector<vector<int> > old_hz = resumed.hz;
+      resumed.resample();
+      int begin = i * 2; // old documents in the window of this step
+      for(int d = 0; d < lda.num_docs; ++d) {
+        TS_ASSERT_EQUALS(resumed.is_swept(d), d >= begin && d < begin + 2);
+        if(!resumed.is_swept(d)) {
+          TS_ASSERT(resumed.hz[d] == old_hz[d]);
+        }
+      }
+    }
+    remove_outputs(tmp_base);
+  }
+
+  void test_resume_parallel() {
+    string tmp_base = "./test.tmp";
+    lda.set_save_state(true);
+    lda.load_data(lda.data_file);
+    lda.initialize();
+    lda.preprocess();
+    lda.resample();
+    lda.save_params(tmp_base);
+
+    // workers sample the ranges of the window and new documents given by the master
+    LDA resumed(lda.data_file, "", 2, 0.1, 0.1);
+    resumed.set_resume(tmp_base, lda.data_file, 0.5);
+    resumed.set_threads(2, 3);
+    resumed.initialize();
+    resumed.preprocess();
+    int num_changes = 0;
+    for(int i = 0; i < 4; ++i) {
+      vector<vector<int> > old_hz = resumed.hz;
+      resumed.resample();
+      num_changes += resumed.num_changes;
+      for(int d = 0; d < lda.num_docs; ++d) {
+        if(!resumed.is_swept(d)) {
+          TS_ASSERT(resumed.hz[d] == old_hz[d]);
+        }
+      }
+    }
+    TS_ASSERT(num_changes > 0);
+    TS_ASSERT_EQUALS(sum(resumed.cz), 2 * lda.num_terms);
+    remove_outputs(tmp_base);
+  }
+
+  void test_save_sparse_params() {
+    string tmp_base = "./test.tmp";
+    lda.set_sparse_output(1);
+    lda.load_data(lda.data_file);
+    lda.initialize();
+    lda.preprocess();
+    lda.resample();
+    lda.save_params(tmp_base);
+
+    // top-1 of each document and topic, and all non-zero counts of each topic
+    vector<string> lines, entries;
+    string line;
+    ifstream theta_file((tmp_base + ".theta").c_str());
+    while(getline(theta_file, line)) lines.push_back(line);
+    TS_ASSERT_EQUALS(lines.size(), lda.num_docs);
+    for(int d = 0; d < lda.num_docs; ++d) {
+      split(lines[d], ' ', entries);
+      TS_ASSERT_EQUALS(entries.size(), 2); // with a trailing space
+      TS_ASSERT_EQUALS(entries[0].substr(0, 2), str(argmax(lda.theta[d])) + ":");
+    }
+
+    lines.clear();
+    ifstream phi_file((tmp_base + ".phi").c_str());
+    while(getline(phi_file, line)) lines.push_back(line);
+    TS_ASSERT_EQUALS(lines.size(), lda.num_topics);
+
+    lines.clear();
+    ifstream smp_file((tmp_base + ".smp").c_str());
+    while(getline(smp_file, line)) lines.push_back(line);
+    TS_ASSERT_EQUALS(lines.size(), lda.num_topics);
+    int num_tokens = 0;
+    for(int z = 0; z < lda.num_topics; ++z) {
+      split(lines[z], ' ', entries);
+      for(size_t k = 0; k < entries.size(); ++k) {
+        if(entries[k] == "") continue;
+        num_tokens += atoi(entries[k].substr(entries[k].find(':') + 1).c_str());
+      }
+    }
+    TS_ASSERT_EQUALS(num_tokens, lda.num_terms);
+    remove_outputs(tmp_base);
+  }
 };
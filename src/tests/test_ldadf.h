@@ -1,6 +1,8 @@
 #include <cxxtest/TestSuite.h>
 
+#include <algorithm>
 #include <fstream>
+#include <stdexcept>
 using namespace std;
 
 #include "../ldadf.h"
@@ -41,16 +43,14 @@ public:
   void test_initialize() {
     lda.initialize();
 
-    TS_ASSERT_EQUALS(lda.ctz.size(), lda.num_dtrees);
-    TS_ASSERT_EQUALS(lda.ctze.size(), lda.num_dtrees);
+    TS_ASSERT_EQUALS(lda.dtree_eps.size(), lda.num_dtrees);
+    TS_ASSERT_EQUALS(lda.dtree_np.size(), lda.num_dtrees);
     for(int t = 0; t < lda.num_dtrees; ++t) {
-      TS_ASSERT_EQUALS(lda.ctz[t].size(), lda.num_topics);
-      TS_ASSERT_EQUALS(lda.ctze[t].size(), lda.num_topics);
+      TS_ASSERT_EQUALS(lda.dtree_eps[t].size(), (*lda.dtrees)[t].eps.size());
       for(int z = 0; z < lda.num_topics; ++z) {
-        TS_ASSERT_EQUALS(lda.ctz[t][z], 0);
-        TS_ASSERT_EQUALS(lda.ctze[t][z].size(), lda.dtrees[t].eps.size());
-        for(int e = 0; e < lda.dtrees[t].eps.size(); ++e) {
-          TS_ASSERT_EQUALS(lda.ctze[t][z][e], 0);
+        TS_ASSERT_EQUALS(lda.get_ctz(t, z), 0);
+        for(int e = 0; e < (*lda.dtrees)[t].eps.size(); ++e) {
+          TS_ASSERT_EQUALS(lda.get_ctze(t, z, e), 0);
         }
       }
     }
@@ -66,38 +66,38 @@ public:
 
     int sum_cdz = 0;
     for(int d = 0; d < lda.num_docs; ++d) {
-      TS_ASSERT_EQUALS(sum(lda.cdz[d]), lda.nd.size());
-      sum_cdz += sum(lda.cdz[d]);
+      TS_ASSERT_EQUALS(lda.cdz.row_sum(d), lda.nd.size());
+      sum_cdz += lda.cdz.row_sum(d);
     }
     TS_ASSERT_EQUALS(sum_cdz, lda.num_terms);
 
     int sum_cwz = 0;
     for(int w = 0; w < lda.num_words; ++w) {
-      sum_cwz += sum(lda.cwz[w]);
+      sum_cwz += lda.cwz.row_sum(w);
     }
     TS_ASSERT_EQUALS(sum_cwz, lda.num_terms);
 
     for(int t = 0; t < lda.num_dtrees; ++t) {
-      DTree &dt = lda.dtrees[t];
+      const DTree &dt = (*lda.dtrees)[t];
       for(int z = 0; z < lda.num_topics; ++z) {
         int ctz = 0;
-        vector<int> ctze(lda.ctze[t][z].size(), 0);
+        vector<int> ctze(dt.eps.size(), 0);
         for(int w = 0; w < lda.num_words; ++w) {
           int e;
           switch(dt.get_type(w)) {
           case DTree::Ep:
             e = dt.get_ep(w);
-            ctze[e] += lda.cwz[w][z];
-            ctz += lda.cwz[w][z];
+            ctze[e] += lda.cwz.get(w, z);
+            ctz += lda.cwz.get(w, z);
             break;
           case DTree::None:
-            ctz += lda.cwz[w][z];
+            ctz += lda.cwz.get(w, z);
             break;
           }
         }
-        TS_ASSERT_EQUALS(ctz, lda.ctz[t][z]);
+        TS_ASSERT_EQUALS(ctz, lda.get_ctz(t, z));
         for(int e = 0; e < dt.eps.size(); ++e) {
-          TS_ASSERT_EQUALS(ctze[e], lda.ctze[t][z][e]);
+          TS_ASSERT_EQUALS(ctze[e], lda.get_ctze(t, z, e));
         }
       }
     }
@@ -113,6 +113,63 @@ public:
     }
   }
 
+  void test_resample_parallel() {
+    lda.set_threads(2, 3);
+    lda.initialize();
+    lda.preprocess();
+    for(int i = 0; i < 5; ++i) {
+      lda.resample();
+    }
+
+    // merged counts of eps/nps are consistent with cwz
+    vector<vector<int> > cez(lda.cez.size(), vector<int>(lda.num_topics, 0));
+    vector<vector<int> > cnz(lda.cnz.size(), vector<int>(lda.num_topics, 0));
+    for(int w = 0; w < lda.num_words; ++w) {
+      for(int z = 0; z < lda.num_topics; ++z) {
+        for(size_t k = 0; k < lda.word_eps[w].size(); ++k) {
+          cez[lda.word_eps[w][k]][z] += lda.cwz.get(w, z);
+        }
+        for(size_t k = 0; k < lda.word_nps[w].size(); ++k) {
+          cnz[lda.word_nps[w][k]][z] += lda.cwz.get(w, z);
+        }
+      }
+    }
+    vector<vector<int> > lda_cez, lda_cnz;
+    lda.cez.to_vector(lda_cez);
+    lda.cnz.to_vector(lda_cnz);
+    TS_ASSERT(cez == lda_cez);
+    TS_ASSERT(cnz == lda_cnz);
+    int num_tokens = 0;
+    for(int z = 0; z < lda.num_topics; ++z) {
+      num_tokens += lda.cz[z];
+    }
+    TS_ASSERT_EQUALS(num_tokens, lda.num_terms);
+  }
+
+  void test_warm_start() {
+    lda.initialize();
+    lda.preprocess();
+    for(int i = 0; i < 5; ++i) {
+      lda.resample();
+    }
+    lda.save_params(tmp_file);
+
+    LDADF warm(lda.data_file, "", lda.num_topics, 1.0, 0.01, 10, 10, 5, false, 1, false, lda.dnf_file, 10);
+    warm.set_warm_start(tmp_file);
+    warm.initialize();
+    warm.preprocess();
+    TS_ASSERT(warm.dz == lda.dz);
+    int num_tokens = 0;
+    for(int z = 0; z < warm.num_topics; ++z) {
+      num_tokens += warm.cz[z];
+    }
+    TS_ASSERT_EQUALS(num_tokens, warm.num_terms);
+    remove((tmp_file + ".phi").c_str());
+    remove((tmp_file + ".theta").c_str());
+    remove((tmp_file + ".smp").c_str());
+    remove((tmp_file + ".dti").c_str());
+  }
+
   void test_resample_post_pre() {
     lda.initialize();
     lda.dz[0] = 0;
@@ -126,28 +183,28 @@ public:
       lda.resample_post(3, 2, 0);
     }
 
-    TS_ASSERT_EQUALS(lda.cdz[0][1], 4);
-    TS_ASSERT_EQUALS(lda.cdz[1][0], 4);
-    TS_ASSERT_EQUALS(lda.cdz[2][1], 4);
-    TS_ASSERT_EQUALS(lda.cdz[3][0], 4);
-    TS_ASSERT_EQUALS(lda.cdz[0][0], 0);
-    TS_ASSERT_EQUALS(lda.cdz[1][1], 0);
-    TS_ASSERT_EQUALS(lda.cdz[2][0], 0);
-    TS_ASSERT_EQUALS(lda.cdz[3][1], 0);
+    TS_ASSERT_EQUALS(lda.cdz.get(0, 1), 4);
+    TS_ASSERT_EQUALS(lda.cdz.get(1, 0), 4);
+    TS_ASSERT_EQUALS(lda.cdz.get(2, 1), 4);
+    TS_ASSERT_EQUALS(lda.cdz.get(3, 0), 4);
+    TS_ASSERT_EQUALS(lda.cdz.get(0, 0), 0);
+    TS_ASSERT_EQUALS(lda.cdz.get(1, 1), 0);
+    TS_ASSERT_EQUALS(lda.cdz.get(2, 0), 0);
+    TS_ASSERT_EQUALS(lda.cdz.get(3, 1), 0);
     TS_ASSERT_EQUALS(lda.cz[0], 8);
     TS_ASSERT_EQUALS(lda.cz[1], 8);
-    TS_ASSERT_EQUALS(lda.cwz[0][0], 4);
-    TS_ASSERT_EQUALS(lda.cwz[0][1], 4);
-    TS_ASSERT_EQUALS(lda.cwz[1][0], 0);
-    TS_ASSERT_EQUALS(lda.cwz[1][1], 4);
-    TS_ASSERT_EQUALS(lda.cwz[2][0], 4);
-    TS_ASSERT_EQUALS(lda.cwz[2][1], 0);
-
-    TS_ASSERT_EQUALS(lda.ctz[0][0], 4);
-    TS_ASSERT_EQUALS(lda.ctze[0][0].size(), 0);
-    TS_ASSERT_EQUALS(lda.ctz[1][1], 8);
-    TS_ASSERT_EQUALS(lda.ctze[1][1].size(), 1);
-    TS_ASSERT_EQUALS(lda.ctze[1][1][0], 8);
+    TS_ASSERT_EQUALS(lda.cwz.get(0, 0), 4);
+    TS_ASSERT_EQUALS(lda.cwz.get(0, 1), 4);
+    TS_ASSERT_EQUALS(lda.cwz.get(1, 0), 0);
+    TS_ASSERT_EQUALS(lda.cwz.get(1, 1), 4);
+    TS_ASSERT_EQUALS(lda.cwz.get(2, 0), 4);
+    TS_ASSERT_EQUALS(lda.cwz.get(2, 1), 0);
+
+    TS_ASSERT_EQUALS(lda.get_ctz(0, 0), 4);
+    TS_ASSERT_EQUALS(lda.dtree_eps[0].size(), 0);
+    TS_ASSERT_EQUALS(lda.get_ctz(1, 1), 8);
+    TS_ASSERT_EQUALS(lda.dtree_eps[1].size(), 1);
+    TS_ASSERT_EQUALS(lda.get_ctze(1, 1, 0), 8);
 
     // reversed fixed-sampling
     for(int i = 0; i < 4; ++i) {
@@ -157,43 +214,71 @@ public:
       lda.resample_pre(3, 2, 0);
     }
 
-    TS_ASSERT_EQUALS(lda.cdz[0][1], 0);
-    TS_ASSERT_EQUALS(lda.cdz[1][0], 0);
-    TS_ASSERT_EQUALS(lda.cdz[2][1], 0);
-    TS_ASSERT_EQUALS(lda.cdz[3][0], 0);
-    TS_ASSERT_EQUALS(lda.cdz[0][0], 0);
-    TS_ASSERT_EQUALS(lda.cdz[1][1], 0);
-    TS_ASSERT_EQUALS(lda.cdz[2][0], 0);
-    TS_ASSERT_EQUALS(lda.cdz[3][1], 0);
+    TS_ASSERT_EQUALS(lda.cdz.get(0, 1), 0);
+    TS_ASSERT_EQUALS(lda.cdz.get(1, 0), 0);
+    TS_ASSERT_EQUALS(lda.cdz.get(2, 1), 0);
+    TS_ASSERT_EQUALS(lda.cdz.get(3, 0), 0);
+    TS_ASSERT_EQUALS(lda.cdz.get(0, 0), 0);
+    TS_ASSERT_EQUALS(lda.cdz.get(1, 1), 0);
+    TS_ASSERT_EQUALS(lda.cdz.get(2, 0), 0);
+    TS_ASSERT_EQUALS(lda.cdz.get(3, 1), 0);
     TS_ASSERT_EQUALS(lda.cz[0], 0);
     TS_ASSERT_EQUALS(lda.cz[1], 0);
-    TS_ASSERT_EQUALS(lda.cwz[0][0], 0);
-    TS_ASSERT_EQUALS(lda.cwz[0][1], 0);
-    TS_ASSERT_EQUALS(lda.cwz[1][0], 0);
-    TS_ASSERT_EQUALS(lda.cwz[1][1], 0);
-    TS_ASSERT_EQUALS(lda.cwz[2][0], 0);
-    TS_ASSERT_EQUALS(lda.cwz[2][1], 0);
-
-    TS_ASSERT_EQUALS(lda.ctz[0][0], 0);
-    TS_ASSERT_EQUALS(lda.ctze[0][0].size(), 0);
-    TS_ASSERT_EQUALS(lda.ctz[1][1], 0);
-    TS_ASSERT_EQUALS(lda.ctze[1][1].size(), 1);
-    TS_ASSERT_EQUALS(lda.ctze[1][1][0], 0);
+    TS_ASSERT_EQUALS(lda.cwz.get(0, 0), 0);
+    TS_ASSERT_EQUALS(lda.cwz.get(0, 1), 0);
+    TS_ASSERT_EQUALS(lda.cwz.get(1, 0), 0);
+    TS_ASSERT_EQUALS(lda.cwz.get(1, 1), 0);
+    TS_ASSERT_EQUALS(lda.cwz.get(2, 0), 0);
+    TS_ASSERT_EQUALS(lda.cwz.get(2, 1), 0);
+
+    TS_ASSERT_EQUALS(lda.get_ctz(0, 0), 0);
+    TS_ASSERT_EQUALS(lda.dtree_eps[0].size(), 0);
+    TS_ASSERT_EQUALS(lda.get_ctz(1, 1), 0);
+    TS_ASSERT_EQUALS(lda.dtree_eps[1].size(), 1);
+    TS_ASSERT_EQUALS(lda.get_ctze(1, 1, 0), 0);
   }
 
   void test_load_dnf() {
     lda.load_dnf(lda.dnf_file);
-    TS_ASSERT_EQUALS(lda.dtrees.size(), 2);
-    TS_ASSERT_EQUALS(lda.dtrees[0].eps.size(), 0);
-    TS_ASSERT_EQUALS(lda.dtrees[0].np.size(), 2);
-    TS_ASSERT_EQUALS(lda.dtrees[0].np[0], 0);
-    TS_ASSERT_EQUALS(lda.dtrees[0].np[1], 1);
-    TS_ASSERT_EQUALS(lda.dtrees[1].eps.size(), 1);
-    TS_ASSERT_EQUALS(lda.dtrees[1].eps[0].size(), 2);
-    TS_ASSERT_EQUALS(lda.dtrees[1].eps[0][0], 0);
-    TS_ASSERT_EQUALS(lda.dtrees[1].eps[0][1], 1);
-    TS_ASSERT_EQUALS(lda.dtrees[1].np.size(), 1);
-    TS_ASSERT_EQUALS(lda.dtrees[1].np[0], 2);
+    TS_ASSERT_EQUALS(lda.dtrees->size(), 2);
+    TS_ASSERT_EQUALS((*lda.dtrees)[0].eps.size(), 0);
+    TS_ASSERT_EQUALS((*lda.dtrees)[0].np.size(), 2);
+    TS_ASSERT_EQUALS((*lda.dtrees)[0].np[0], 0);
+    TS_ASSERT_EQUALS((*lda.dtrees)[0].np[1], 1);
+    TS_ASSERT_EQUALS((*lda.dtrees)[1].eps.size(), 1);
+    TS_ASSERT_EQUALS((*lda.dtrees)[1].eps[0].size(), 2);
+    TS_ASSERT_EQUALS((*lda.dtrees)[1].eps[0][0], 0);
+    TS_ASSERT_EQUALS((*lda.dtrees)[1].eps[0][1], 1);
+    TS_ASSERT_EQUALS((*lda.dtrees)[1].np.size(), 1);
+    TS_ASSERT_EQUALS((*lda.dtrees)[1].np[0], 2);
+  }
+
+  void test_index_dtrees() {
+    ofstream file(tmp_file.c_str());
+    file << ";1,0\n0,1;2\n0,2;1\n;2,0\n1,0;2"; // Ep(0,1) shared by 2nd and 5th
+    file.close();
+
+    lda.dnf_file = tmp_file;
+    lda.initialize();
+
+    TS_ASSERT_EQUALS(lda.cez.size(), 2);
+    TS_ASSERT_EQUALS(lda.cnz.size(), 4);
+    TS_ASSERT_EQUALS(lda.dtree_eps[1][0], lda.dtree_eps[4][0]);
+    TS_ASSERT_EQUALS(lda.dtree_np[1], lda.dtree_np[4]);
+    TS_ASSERT_EQUALS(lda.word_eps[0].size(), 2);
+    TS_ASSERT_EQUALS(lda.word_nps[1].size(), 2);
+
+    lda.preprocess();
+    for(int z = 0; z < lda.num_topics; ++z) {
+      TS_ASSERT_EQUALS(lda.get_ctz(1, z), lda.get_ctz(4, z));
+      TS_ASSERT_EQUALS(lda.get_ctze(1, z, 0), lda.cwz.get(0, z) + lda.cwz.get(1, z));
+      TS_ASSERT_EQUALS(lda.get_ctz(0, z), lda.cwz.get(2, z));
+    }
+
+    file.open(tmp_file.c_str());
+    file << ";1,0\n0,3;2"; // no word 3 in the data
+    file.close();
+    TS_ASSERT_THROWS(lda.initialize(), runtime_error);
   }
 
   void test_calc_dtree_probs() {
@@ -313,7 +398,7 @@ public:
     // preprocess by sample_hz
     for(int d = 0; d < lda.num_docs; ++d) {
       for(int i = 0; i < lda.nd[d]; ++i) {
-        int w = lda.docs[d][i];
+        int w = (*lda.docs)[d][i];
         int z = sample_hz[d][i];
         lda.resample_post(d, w, z);
       }
@@ -334,6 +419,67 @@ public:
     }
   }
 
+  void test_calc_dtree_delta_weight() {
+    lda.initialize();
+    lda.preprocess();
+
+    vector<double> probs(lda.num_dtrees);
+    for(int z = 0; z < lda.num_topics; ++z) {
+      lda.calc_dtree_probs(z, probs); // fills ep_word_weights for z
+      double base = lda.calc_dtree_base_weight(z);
+      for(int t = 0; t < lda.num_dtrees; ++t) {
+        TS_ASSERT_DELTA(base + lda.calc_dtree_delta_weight(z, t), lda.calc_dtree_prob_weight(z, t), delta);
+      }
+    }
+  }
+
+  void test_log_likelihood() {
+    lda.initialize();
+    lda.preprocess();
+    TS_ASSERT_DELTA(lda.get_log_likelihood(), lda.calc_log_likelihood(), delta);
+    for(int i = 0; i < 20; ++i) {
+      lda.resample(); // including dtree changes
+      TS_ASSERT_DELTA(lda.get_log_likelihood(), lda.calc_log_likelihood(), delta);
+    }
+  }
+
+  void test_compact_words() {
+    // words 0, 2 and 5 in the data, where the dnf also has 1 and 7
+    int indptr[] = {0, 2, 4};
+    int indices[] = {0, 5, 2, 5};
+    int freqs[] = {2, 1, 2, 1};
+    vector<string> dnf;
+    dnf.push_back("0,1:5,7;2");
+    lda = LDADF("", "", 2, 1.0, 0.01);
+    lda.set_compact_words(true);
+    lda.set_data(2, indptr, indices, freqs);
+    lda.set_dnf(dnf);
+    lda.initialize();
+    TS_ASSERT_EQUALS(lda.num_words, 3);
+    TS_ASSERT_EQUALS((*lda.dtrees)[0].str(), "Ep(0)^Ep(2)^Np(1)");
+    TS_ASSERT_EQUALS((*lda.parsed_dtrees)[0].str(), "Ep(0,1)^Ep(5,7)^Np(2)");
+    lda.preprocess();
+    lda.resample();
+    TS_ASSERT_DELTA(lda.get_log_likelihood(), lda.calc_log_likelihood(), delta);
+  }
+
+  void test_calc_weights() {
+    lda.initialize();
+    lda.preprocess();
+
+    vector<double> probs(lda.num_topics);
+    vector<double> cum(lda.num_topics);
+    for(int w = 0; w < lda.num_words; ++w) {
+      lda.calc_probs(0, w, probs);
+      double s = lda.calc_weights(0, w, cum);
+      TS_ASSERT_DELTA(cum[lda.num_topics-1], s, delta);
+      for(int z = 0; z < lda.num_topics; ++z) {
+        double prev = z > 0 ? cum[z-1] : 0.0;
+        TS_ASSERT_DELTA((cum[z] - prev) / s, probs[z], delta);
+      }
+    }
+  }
+
   void test_calc_prob_weight() {
     lda.initialize();
     lda.dz[0] = 0;
@@ -380,4 +526,107 @@ public:
     TS_ASSERT_EQUALS(lda.calc_prob_weight(2, 1), // Np(2)
                      (0 + beta) / (8 + beta * eta * num_nonp + beta * num_np));
   }
+
+  void test_coefs() {
+    lda.initialize();
+    lda.preprocess();
+    lda.resample();
+
+    // primitives as sampled, and recoded as the dtree of topic 0 is changed
+    for(int t = -1; t < lda.num_dtrees; ++t) {
+      if(t >= 0) {
+        lda.dz[0] = t;
+        lda.update_coefs(0);
+      }
+      for(int z = 0; z < lda.num_topics; ++z) {
+        const DTree &dtree = (*lda.dtrees)[lda.dz[z]];
+        for(int w = 0; w < lda.num_words; ++w) {
+          int prim = lda.get_prim(w, z);
+          switch(dtree.get_type(w)) {
+          case DTree::Ep: TS_ASSERT_EQUALS(prim, dtree.get_ep(w)); break;
+          case DTree::Np: TS_ASSERT_EQUALS(prim, LDADF::PRIM_NP); break;
+          default: TS_ASSERT_EQUALS(prim, LDADF::PRIM_NONE); break;
+          }
+        }
+      }
+    }
+    for(int z = 0; z < lda.num_topics; ++z) {
+      double none_coef = lda.none_coefs[z];
+      lda.update_coefs(z);
+      TS_ASSERT_EQUALS(lda.none_coefs[z], none_coef);
+    }
+  }
+
+  void test_sample_topic_buckets() {
+    lda.initialize();
+    lda.preprocess();
+    lda.bucketed = true;
+    lda.index_word_topics();
+    for(int w = 0; w < lda.num_words; ++w) {
+      for(int z = 0; z < lda.num_topics; ++z) {
+        bool nonzero = find(lda.nonzero_topics[w].begin(), lda.nonzero_topics[w].end(), z)
+          != lda.nonzero_topics[w].end();
+        TS_ASSERT_EQUALS(nonzero, lda.cwz.get(w, z) > 0);
+      }
+    }
+
+    // sums of buckets kept by resample_pre/post() as recomputed
+    lda.cache_doc(0);
+    lda.resample_pre(0, 0, 0);
+    lda.resample_post(0, 0, 1);
+    double smooth_mass = lda.smooth_mass;
+    double doc_mass = lda.doc_mass;
+    TS_ASSERT_EQUALS(lda.bucket_doc, 0);
+    lda.cache_doc(0);
+    TS_ASSERT_DELTA(lda.smooth_mass, smooth_mass, delta);
+    TS_ASSERT_DELTA(lda.doc_mass, doc_mass, delta);
+
+    // frequencies of sampled topics as the conditional
+    set_seed(0);
+    int num_samples = 20000;
+    vector<double> probs(lda.num_topics);
+    vector<int> counts(lda.num_topics);
+    for(int w = 0; w < lda.num_words; ++w) {
+      lda.calc_probs(0, w, probs);
+      counts.assign(lda.num_topics, 0);
+      for(int i = 0; i < num_samples; ++i) {
+        ++counts[lda.sample_topic(0, w)];
+      }
+      for(int z = 0; z < lda.num_topics; ++z) {
+        TS_ASSERT_DELTA((double)counts[z] / num_samples, probs[z], 0.02);
+      }
+    }
+  }
+
+  void test_sample_topic_buckets_parallel() {
+    // workers sample one-document tasks by buckets, whose sums are not carried
+    // over from the previous task of the worker
+    lda = LDADF("../data/test.dat", "", 64, 1.0, 0.01, 10, 10, 5, false, 0, false,
+                "../data/test.dnf", 10);
+    lda.set_threads(2, 2);
+    lda.initialize();
+    lda.preprocess();
+    TS_ASSERT(lda.bucketed);
+    for(int i = 0; i < 3; ++i) {
+      lda.resample();
+    }
+    for(size_t t = 0; t < lda.workers.size(); ++t) {
+      LDADF &worker = dynamic_cast<LDADF &>(*lda.workers[t]);
+      if(worker.bucket_doc < 0) continue; // no task of the worker in the last step
+      double smooth_mass = worker.smooth_mass;
+      double doc_mass = worker.doc_mass;
+      worker.cache_doc(0);
+      TS_ASSERT_DELTA(worker.smooth_mass, smooth_mass, delta);
+      TS_ASSERT_DELTA(worker.doc_mass, doc_mass, delta);
+    }
+  }
+
+  void test_bucketed_word_major() {
+    // dense conditional for word-major sweeps, where the document changes at each token
+    lda = LDADF("../data/test.dat", "", 64, 1.0, 0.01, 10, 10, 5, false, 0, false,
+                "../data/test.dnf", 10);
+    lda.set_word_major(true);
+    lda.initialize();
+    TS_ASSERT(!lda.bucketed);
+  }
 };
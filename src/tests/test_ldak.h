@@ -0,0 +1,56 @@
+#include <cxxtest/TestSuite.h>
+
+#include <cstdlib>
+using namespace std;
+
+#include "../ldak.h"
+#include "../utils.h"
+using namespace ldautils;
+
+class TestLDAK : public CxxTest::TestSuite {
+  string dat_file;
+  string dnf_file;
+
+ public:
+
+  void setUp() {
+    dat_file = "../data/test.dat";
+    dnf_file = "../data/test.dnf";
+  }
+
+  void tearDown() {
+  }
+
+  void test_sample_topic_ldadf() {
+    LDADFK<16> lda(dat_file, "", 0.1, 0.1, 100, 0, 5, false, 0, false, dnf_file, 10);
+    lda.initialize();
+    lda.preprocess();
+    for(int d = 0; d < lda.num_docs; ++d) {
+      for(int w = 0; w < lda.num_words; ++w) {
+        set_seed(d * lda.num_words + w);
+        int z = lda.LDADF::sample_topic(d, w); // generic
+        set_seed(d * lda.num_words + w);
+        TS_ASSERT_EQUALS(lda.sample_topic(d, w), z);
+      }
+    }
+  }
+
+  void test_create_lda() {
+    LDA *lda = create_lda(dat_file, "", 32, 0.1, 0.1, 100, 0, 5, false, 0, false, dnf_file);
+    TS_ASSERT(dynamic_cast<LDADFK<32>*>(lda) != NULL);
+    delete lda;
+
+    lda = create_lda(dat_file, "", 64, 0.1, 0.1, 100, 0, 5, false, 0, false, dnf_file);
+    TS_ASSERT(dynamic_cast<LDADFK<32>*>(lda) == NULL);
+    TS_ASSERT(dynamic_cast<LDADF*>(lda) != NULL);
+    delete lda;
+
+    lda = create_lda(dat_file, "", 16);
+    TS_ASSERT(dynamic_cast<LDADF*>(lda) == NULL);
+    delete lda;
+
+    lda = create_lda(dat_file, "", 10, 0.1, 0.1, 100, 0, 5, false, 0, false, dnf_file);
+    TS_ASSERT(dynamic_cast<LDADF*>(lda) != NULL);
+    delete lda;
+  }
+};
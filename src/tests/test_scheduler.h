@@ -0,0 +1,51 @@
+#include <cxxtest/TestSuite.h>
+
+#include <atomic>
+#include <vector>
+using namespace std;
+
+#include "../scheduler.h"
+
+class TestTaskScheduler : public CxxTest::TestSuite {
+ public:
+
+  void test_partition() {
+    long weights[] = {5, 1, 4, 2, 3, 3};
+    TaskScheduler scheduler(vector<long>(weights, weights + 6), 2);
+    scheduler.partition();
+    TS_ASSERT_EQUALS(scheduler.queues.size(), 2);
+
+    // balanced loads, each queue in descending weights
+    long loads[2] = {0, 0};
+    for(int t = 0; t < 2; ++t) {
+      for(size_t i = 0; i < scheduler.queues[t].size(); ++i) {
+        loads[t] += weights[scheduler.queues[t][i]];
+        if(i > 0) {
+          TS_ASSERT(weights[scheduler.queues[t][i - 1]] >= weights[scheduler.queues[t][i]]);
+        }
+      }
+    }
+    TS_ASSERT_EQUALS(loads[0], 9);
+    TS_ASSERT_EQUALS(loads[1], 9);
+  }
+
+  void test_run() {
+    int num_tasks = 100;
+    vector<long> weights(num_tasks);
+    for(int k = 0; k < num_tasks; ++k) {
+      weights[k] = k % 7 + 1;
+    }
+    vector<atomic<int> > runs(num_tasks);
+    vector<int> inits(4, 0);
+    TaskScheduler scheduler(weights, 4);
+    scheduler.run([&](int, int k) { ++runs[k]; },
+                  [&](int t) { ++inits[t]; });
+    for(int k = 0; k < num_tasks; ++k) {
+      TS_ASSERT_EQUALS(runs[k], 1);
+    }
+    TS_ASSERT(inits == vector<int>(4, 1));
+    TS_ASSERT(scheduler.get_utilization() > 0.0);
+    TS_ASSERT(scheduler.get_utilization() <= 1.0 + 1e-6);
+    TS_ASSERT(scheduler.get_num_steals() >= 0);
+  }
+};
@@ -1,6 +1,10 @@
 #include <cxxtest/TestSuite.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <fstream>
+#include <stdexcept>
 using namespace std;
 
 #include "../utils.h"
@@ -20,6 +24,15 @@ class TestUtils : public CxxTest::TestSuite {
   void tearDown() {
   }
 
+  /* time */
+
+  void test_get_time() {
+    double t = get_time();
+    TS_ASSERT(t > 0);
+    TS_ASSERT(get_time() >= t);
+    TS_ASSERT(get_peak_rss() > 0);
+  }
+
   /* string */
 
   void test_split() {
@@ -53,6 +66,19 @@ class TestUtils : public CxxTest::TestSuite {
     TS_ASSERT_EQUALS(list[1], "2");
   }
 
+  void test_parse_word_freq() {
+    int w, f;
+    parse_word_freq("12:3", w, f);
+    TS_ASSERT_EQUALS(w, 12);
+    TS_ASSERT_EQUALS(f, 3);
+    TS_ASSERT_THROWS(parse_word_freq("12", w, f), runtime_error);
+    TS_ASSERT_THROWS(parse_word_freq("12:", w, f), runtime_error);
+    TS_ASSERT_THROWS(parse_word_freq(":3", w, f), runtime_error);
+    TS_ASSERT_THROWS(parse_word_freq("1:2:3", w, f), runtime_error);
+    TS_ASSERT_THROWS(parse_word_freq("a:3", w, f), runtime_error);
+    TS_ASSERT_THROWS(parse_word_freq("-1:3", w, f), runtime_error);
+  }
+
   /* math */
 
   void test_math() {
@@ -70,8 +96,38 @@ class TestUtils : public CxxTest::TestSuite {
     TS_ASSERT_DELTA(digamma(10), 2.25175258, delta);
   }
   
+  void test_rhat() {
+    vector<vector<double> > traces(2, vector<double>(4));
+    double t0[] = {1.0, 2.0, 3.0, 2.0};
+    double t1[] = {2.0, 1.0, 2.0, 3.0};
+    traces[0].assign(t0, t0 + 4);
+    traces[1].assign(t1, t1 + 4);
+    // W = 2/3, B = 0, var = 3/4 * W
+    TS_ASSERT_DELTA(rhat(traces), sqrt(0.75), delta);
+    traces[1].assign(4, 100.0);
+    TS_ASSERT(rhat(traces) > 10.0);
+  }
+
   /* prob */
 
+  void test_set_seed() {
+    // same sequence as rand() after srand() in each thread
+    vector<double> cum(100);
+    for(int i = 0; i < 100; ++i) {
+      cum[i] = i + 1.0;
+    }
+    set_seed(7);
+    vector<int> samples;
+    for(int i = 0; i < 10; ++i) {
+      samples.push_back(multi_cum(&cum[0], 100));
+    }
+    srand(7);
+    for(int i = 0; i < 10; ++i) {
+      double r = rand() * (1.0 / RAND_MAX) * cum[99];
+      TS_ASSERT_EQUALS(samples[i], upper_bound(cum.begin(), cum.end(), r) - cum.begin());
+    }
+  }
+
   void test_norm() {
     vector<double> vec(2, 1.0);
     norm(vec);
@@ -92,6 +148,32 @@ class TestUtils : public CxxTest::TestSuite {
     TS_ASSERT_EQUALS(multi(vec2), 9);
   }
 
+  void test_multi_cum() {
+    double cum[] = {0.0, 2.0, 2.0};
+    TS_ASSERT_EQUALS(multi_cum(cum, 3), 1);
+    double cum2[] = {0.0, 0.0, 0.0, 5.0};
+    TS_ASSERT_EQUALS(multi_cum(cum2, 4), 3);
+  }
+
+  void test_cum_prod_ratio() {
+    int size = 11; // vector body and scalar tail
+    vector<int> a(size), b(size), c(size);
+    vector<double> b0(size), cum(size);
+    for(int j = 0; j < size; ++j) {
+      a[j] = j;
+      b[j] = 2 * j + 1;
+      c[j] = size - j;
+      b0[j] = 0.1 * j;
+    }
+    double s = cum_prod_ratio(&a[0], 0.5, &b[0], &b0[0], &c[0], 1.5, size, &cum[0]);
+    double true_s = 0.0;
+    for(int j = 0; j < size; ++j) {
+      true_s += (a[j] + 0.5) * (b[j] + b0[j]) / (c[j] + 1.5);
+      TS_ASSERT_DELTA(cum[j], true_s, delta);
+    }
+    TS_ASSERT_DELTA(s, true_s, delta);
+  }
+
   /* matrix */
 
   void test_transpose() {
@@ -165,6 +247,42 @@ class TestUtils : public CxxTest::TestSuite {
     }
   }
 
+  void test_save_sparse_matrix() {
+    double matval[2][4] = {
+      {0.1, 0.4, 0.2, 0.3},
+      {0.5, 0.0, 0.5, 0.0},
+    };
+    vector<vector<double> > mat;
+    for(int i = 0; i < 2; ++i) {
+      mat.push_back(vector<double>(matval[i], matval[i] + 4));
+    }
+
+    // top-2 in descending values (ties in ascending indices)
+    save_sparse_matrix(tmp_file, mat, 2, 0.0);
+    string line;
+    ifstream file(tmp_file.c_str());
+    const char *true_top[] = {
+      "1:0.4 3:0.3 ",
+      "0:0.5 2:0.5 "
+    };
+    for(int i = 0; getline(file, line); ++i) {
+      TS_ASSERT_EQUALS(line, true_top[i]);
+    }
+    file.close();
+
+    // values >= threshold, in given ids
+    int ids[] = {10, 11, 12, 13};
+    save_sparse_matrix(tmp_file, mat, 0, 0.25, vector<int>(ids, ids + 4));
+    file.open(tmp_file.c_str());
+    const char *true_threshold[] = {
+      "11:0.4 13:0.3 ",
+      "10:0.5 12:0.5 "
+    };
+    for(int i = 0; getline(file, line); ++i) {
+      TS_ASSERT_EQUALS(line, true_threshold[i]);
+    }
+  }
+
   void test_load_matrix() {
     ofstream file(tmp_file.c_str());
     file << "1.1 1.2 1.3 " << endl;
@@ -184,5 +302,29 @@ class TestUtils : public CxxTest::TestSuite {
     }
   }
 
+  void test_load_sparse_matrix() {
+    ofstream file(tmp_file.c_str());
+    file << "2:1.3 0:1.1 " << endl;
+    file << "1:2.2 " << endl;
+    file << endl;
+    file.close();
+    vector<vector<double> > mat;
+    load_matrix(tmp_file, mat);
+
+    // expanded to the widest index
+    double true_mat[3][3] = {
+      {1.1, 0.0, 1.3},
+      {0.0, 2.2, 0.0},
+      {0.0, 0.0, 0.0}
+    };
+    TS_ASSERT_EQUALS(mat.size(), 3);
+    for(int i = 0; i < 3; ++i) {
+      TS_ASSERT_EQUALS(mat[i].size(), 3);
+      for(int j = 0; j < 3; ++j) {
+        TS_ASSERT_DELTA(mat[i][j], true_mat[i][j], delta);
+      }
+    }
+  }
+
 };
 
@@ -2,14 +2,23 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
 
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <numeric>
 #include <sstream>
 using namespace std;
 
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 namespace ldautils {
 
   /* print */
@@ -28,6 +37,22 @@ namespace ldautils {
     }
   }
 
+  /* time */
+
+  double
+  get_time() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+  }
+
+  long
+  get_peak_rss() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // kilobytes on linux
+  }
+
   /* string */
 
   void 
@@ -43,6 +68,23 @@ namespace ldautils {
     }
   }
 
+  void
+  parse_word_freq(const string &s, int &word, int &freq) {
+    // throws instead of assert(), which is compiled out of the Python bindings
+    const char *begin = s.c_str();
+    char *end;
+    word = strtol(begin, &end, 10);
+    bool valid = end != begin && *end == ':';
+    if(valid) {
+      begin = end + 1;
+      freq = strtol(begin, &end, 10);
+      valid = end != begin && *end == '\0' && word >= 0 && freq >= 0;
+    }
+    if(!valid) {
+      throw runtime_error("parse_word_freq(): expected word:freq but " + s);
+    }
+  }
+
   template <typename T>
   string
   str(T n) {
@@ -95,6 +137,35 @@ namespace ldautils {
     return result;
   }
 
+  // potential scale reduction factor (Gelman-Rubin) of traces[chain][step]
+  double
+  rhat(const vector<vector<double> > &traces) {
+    int m = traces.size();
+    assert(m >= 2);
+    int n = traces[0].size();
+    assert(n >= 2);
+    vector<double> means(m, 0.0);
+    double w = 0.0; // within-chain variance
+    for(int c = 0; c < m; ++c) {
+      means[c] = sum(traces[c]) / n;
+      double s2 = 0.0;
+      for(int i = 0; i < n; ++i) {
+        s2 += (traces[c][i] - means[c]) * (traces[c][i] - means[c]);
+      }
+      w += s2 / (n - 1) / m;
+    }
+    double mean = sum(means) / m;
+    double b = 0.0; // between-chain variance
+    for(int c = 0; c < m; ++c) {
+      b += (means[c] - mean) * (means[c] - mean) * n / (m - 1);
+    }
+    if(w <= 0.0) {
+      return b > 0.0 ? HUGE_VAL : 1.0;
+    }
+    double var = (n - 1.0) / n * w + b / n;
+    return sqrt(var / w);
+  }
+
   /* prob */
 
   void
@@ -113,11 +184,39 @@ namespace ldautils {
 
   const double R_RAND_MAX = 1.0 / RAND_MAX;
 
+  // per-thread state of the same generator as rand(), so that each thread
+  // (e.g. a chain) draws its own sequence from set_seed()
+  static __thread char rand_state[128];
+  static __thread struct random_data rand_data;
+  static __thread bool rand_seeded = false;
+
+  void
+  set_seed(unsigned seed) {
+    rand_data.state = NULL; // required by initstate_r()
+    initstate_r(seed, rand_state, sizeof(rand_state), &rand_data);
+    rand_seeded = true;
+  }
+
+  static int
+  rand_int() {
+    if(!rand_seeded) {
+      set_seed(1); // as rand() without srand()
+    }
+    int32_t r;
+    random_r(&rand_data, &r);
+    return r;
+  }
+
+  unsigned
+  draw_seed() {
+    return static_cast<unsigned>(rand_int());
+  }
+
   int
   multi(const vector<double> &probs) {
     assert(fabs(sum(probs)-1.0) < 0.0001);
     assert(min(probs) >= 0.0);
-    double r = rand() * R_RAND_MAX; // uniform on (0, 1)
+    double r = rand_int() * R_RAND_MAX; // uniform on (0, 1)
     double p = 0;
     int size = probs.size();
     for(int i = 0; i < size; ++i) {
@@ -129,6 +228,112 @@ namespace ldautils {
     return size-1;
   }
 
+  int
+  multi_cum(const double *cum, int size) {
+    assert(size > 0);
+    double r = rand_int() * R_RAND_MAX * cum[size-1]; // uniform on (0, sum)
+    int i = upper_bound(cum, cum + size, r) - cum; // binary search
+    return i < size ? i : size-1;
+  }
+
+  // fused kernel of weights and their prefix sum (no normalization),
+  // dispatched at runtime to AVX-512/AVX2 if the cpu supports them
+
+  typedef double (*cum_prod_ratio_func)(const int*, double, const int*, const double*, const int*, double, int, double*);
+
+  static double
+  cum_prod_ratio_scalar(const int *a, double a0, const int *b, const double *b0, const int *c, double c0,
+                        int size, double *cum) {
+    double s = 0.0;
+    for(int j = 0; j < size; ++j) {
+      s += (a[j] + a0) * (b[j] + b0[j]) / (c[j] + c0);
+      cum[j] = s;
+    }
+    return s;
+  }
+
+#if defined(__GNUC__) && defined(__x86_64__)
+  __attribute__((target("avx2")))
+  static double
+  cum_prod_ratio_avx2(const int *a, double a0, const int *b, const double *b0, const int *c, double c0,
+                      int size, double *cum) {
+    const __m256d va0 = _mm256_set1_pd(a0);
+    const __m256d vc0 = _mm256_set1_pd(c0);
+    const __m256d zero = _mm256_setzero_pd();
+    __m256d run = zero;
+    int j = 0;
+    for(; j + 4 <= size; j += 4) {
+      __m256d va = _mm256_add_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(a + j))), va0);
+      __m256d vb = _mm256_add_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(b + j))), _mm256_loadu_pd(b0 + j));
+      __m256d vc = _mm256_add_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(c + j))), vc0);
+      __m256d x = _mm256_div_pd(_mm256_mul_pd(va, vb), vc);
+      // in-register prefix sum: shift by 1 and 2 lanes
+      x = _mm256_add_pd(x, _mm256_blend_pd(_mm256_permute4x64_pd(x, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x1));
+      x = _mm256_add_pd(x, _mm256_blend_pd(_mm256_permute4x64_pd(x, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x3));
+      x = _mm256_add_pd(x, run);
+      _mm256_storeu_pd(cum + j, x);
+      run = _mm256_permute4x64_pd(x, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    double s = _mm256_cvtsd_f64(run);
+    for(; j < size; ++j) {
+      s += (a[j] + a0) * (b[j] + b0[j]) / (c[j] + c0);
+      cum[j] = s;
+    }
+    return s;
+  }
+
+  __attribute__((target("avx512f")))
+  static double
+  cum_prod_ratio_avx512(const int *a, double a0, const int *b, const double *b0, const int *c, double c0,
+                        int size, double *cum) {
+    const __m512d va0 = _mm512_set1_pd(a0);
+    const __m512d vc0 = _mm512_set1_pd(c0);
+    const __m512i shift1 = _mm512_set_epi64(6, 5, 4, 3, 2, 1, 0, 0);
+    const __m512i shift2 = _mm512_set_epi64(5, 4, 3, 2, 1, 0, 0, 0);
+    const __m512i shift4 = _mm512_set_epi64(3, 2, 1, 0, 0, 0, 0, 0);
+    const __m512i last = _mm512_set1_epi64(7);
+    __m512d run = _mm512_setzero_pd();
+    int j = 0;
+    for(; j + 8 <= size; j += 8) {
+      __m512d va = _mm512_add_pd(_mm512_cvtepi32_pd(_mm256_loadu_si256((const __m256i*)(a + j))), va0);
+      __m512d vb = _mm512_add_pd(_mm512_cvtepi32_pd(_mm256_loadu_si256((const __m256i*)(b + j))), _mm512_loadu_pd(b0 + j));
+      __m512d vc = _mm512_add_pd(_mm512_cvtepi32_pd(_mm256_loadu_si256((const __m256i*)(c + j))), vc0);
+      __m512d x = _mm512_div_pd(_mm512_mul_pd(va, vb), vc);
+      // in-register prefix sum: shift by 1, 2 and 4 lanes
+      x = _mm512_add_pd(x, _mm512_maskz_permutexvar_pd(0xFE, shift1, x));
+      x = _mm512_add_pd(x, _mm512_maskz_permutexvar_pd(0xFC, shift2, x));
+      x = _mm512_add_pd(x, _mm512_maskz_permutexvar_pd(0xF0, shift4, x));
+      x = _mm512_add_pd(x, run);
+      _mm512_storeu_pd(cum + j, x);
+      run = _mm512_permutexvar_pd(last, x);
+    }
+    double s = _mm512_cvtsd_f64(run);
+    for(; j < size; ++j) {
+      s += (a[j] + a0) * (b[j] + b0[j]) / (c[j] + c0);
+      cum[j] = s;
+    }
+    return s;
+  }
+#endif
+
+  static cum_prod_ratio_func
+  select_cum_prod_ratio() {
+#if defined(__GNUC__) && defined(__x86_64__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) return cum_prod_ratio_avx512;
+    if(__builtin_cpu_supports("avx2")) return cum_prod_ratio_avx2;
+#endif
+    return cum_prod_ratio_scalar;
+  }
+
+  static const cum_prod_ratio_func cum_prod_ratio_impl = select_cum_prod_ratio();
+
+  double
+  cum_prod_ratio(const int *a, double a0, const int *b, const double *b0, const int *c, double c0,
+                 int size, double *cum) {
+    return cum_prod_ratio_impl(a, a0, b, b0, c, c0, size, cum);
+  }
+
   /* matrix */
 
   template <typename T>
@@ -151,8 +356,7 @@ namespace ldautils {
   save_matrix(const string &filename, const vector<vector<T> > &mat) {
     ofstream file(filename.c_str());
     if(!file.is_open()) {
-      cerr << "ldautils::save_matrix(): cannot open " << filename << endl;
-      exit(1);
+      throw runtime_error(string("ldautils::save_matrix(): cannot open ") + filename);
     }
 
     int row = mat.size();
@@ -178,27 +382,77 @@ namespace ldautils {
   load_matrix(const string &filename, vector<vector<double> > &mat) {
     ifstream in(filename.c_str());
     if(!in.is_open()) {
-      cerr << "ldautils::load_matrix(): cannot open " << filename << endl;
-      exit(1);
+      throw runtime_error(string("ldautils::load_matrix(): cannot open ") + filename);
     }
   
     mat.clear();
     string line;
     vector<string> strs;
+    size_t num_cols = 0; // of sparse rows, which are expanded to the widest index
     while(getline(in, line)) {
       split(line, ' ', strs);
       vector<double> vec;
       for(vector<string>::iterator i = strs.begin(); i != strs.end(); ++i) {
         if(*i == "") continue;
-        vec.push_back(atof(i->c_str()));
+        size_t colon = i->find(':');
+        if(colon == string::npos) {
+          vec.push_back(atof(i->c_str()));
+          continue;
+        }
+        size_t j = atoi(i->substr(0, colon).c_str());
+        if(j >= vec.size()) vec.resize(j + 1, 0.0);
+        vec[j] = atof(i->c_str() + colon + 1);
+        num_cols = std::max(num_cols, j + 1);
       }
       mat.push_back(vec);
     }
+    if(num_cols > 0) {
+      for(size_t i = 0; i < mat.size(); ++i) {
+        mat[i].resize(num_cols, 0.0);
+      }
+    }
+  }
+
+  template <typename T>
+  void
+  write_sparse_row(ostream &out, const vector<T> &row, int top_k, double threshold, const vector<int> &ids) {
+    vector<pair<T, int> > entries;
+    for(size_t j = 0; j < row.size(); ++j) {
+      if(row[j] >= threshold) entries.push_back(make_pair(row[j], j));
+    }
+    // descending values, ascending indices on ties
+    auto greater = [](const pair<T, int> &a, const pair<T, int> &b) {
+      return a.first > b.first || (a.first == b.first && a.second < b.second);
+    };
+    if(top_k > 0 && top_k < (int)entries.size()) {
+      partial_sort(entries.begin(), entries.begin() + top_k, entries.end(), greater);
+      entries.resize(top_k);
+    } else {
+      sort(entries.begin(), entries.end(), greater);
+    }
+    for(size_t i = 0; i < entries.size(); ++i) {
+      out << (ids.empty() ? entries[i].second : ids[entries[i].second]) << ":" << entries[i].first << " ";
+    }
+    out << "\n";
+  }
+
+  template <typename T>
+  void
+  save_sparse_matrix(const string &filename, const vector<vector<T> > &mat, int top_k, double threshold,
+                     const vector<int> &ids) {
+    ofstream file(filename.c_str());
+    if(!file.is_open()) {
+      throw runtime_error(string("ldautils::save_sparse_matrix(): cannot open ") + filename);
+    }
+    for(size_t i = 0; i < mat.size(); ++i) {
+      write_sparse_row(file, mat[i], top_k, threshold, ids);
+    }
   }
 
   /* for linking */
   template string str(bool n);
   template string str(int n);
+  template string str(long n);
   template string str(double n);
   template int sum(const vector<int>&);
   template double sum(const vector<double>&);
@@ -207,8 +461,13 @@ namespace ldautils {
   template int min(const vector<int>&);
   template double min(const vector<double>&);
   template int argmax(const vector<double>&);
+  template void transpose(const vector<vector<double> >&, vector<vector<double> >&);
   template void save_matrix(const string&, const vector<vector<int> >&);
   template void save_matrix(const string&, const vector<vector<double> >&);
   template void save_matrix_t(const string&, const vector<vector<int> >&);
   template void save_matrix_t(const string&, const vector<vector<double> >&);
+  template void write_sparse_row(ostream&, const vector<int>&, int, double, const vector<int>&);
+  template void write_sparse_row(ostream&, const vector<double>&, int, double, const vector<int>&);
+  template void save_sparse_matrix(const string&, const vector<vector<int> >&, int, double, const vector<int>&);
+  template void save_sparse_matrix(const string&, const vector<vector<double> >&, int, double, const vector<int>&);
 };
@@ -1,6 +1,7 @@
 #ifndef LDA_UTILS_H
 #define LDA_UTILS_H
 
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -9,9 +10,14 @@ namespace ldautils {
   void set_verbose(bool flag);
   void comment(std::string s);
 
+  // time
+  double get_time(); // wall-clock seconds
+  long get_peak_rss(); // peak resident set size in kilobytes
+
   // string
   void split(const std::string &str, char delim, std::vector<std::string> &vec);
   template <typename T> std::string str(T d);
+  void parse_word_freq(const std::string &s, int &word, int &freq); // "word:freq" of .dat
 
   // math
   template <typename T> T sum(const std::vector<T> &vec);
@@ -19,16 +25,29 @@ namespace ldautils {
   template <typename T> T min(const std::vector<T> &vec);
   template <typename T> int argmax(const std::vector<T> &vec);
   double digamma(double x);
+  double rhat(const std::vector<std::vector<double> > &traces); // traces[chain][step]
   
   // prob
+  void set_seed(unsigned seed); // seed of multi() and multi_cum() in the current thread
+  unsigned draw_seed(); // seed for another thread, drawn from the current thread
   void norm(std::vector<double> &vec);
   int multi(const std::vector<double> &probs);
+  int multi_cum(const double *cum, int size); // cum = unnormalized cumulative weights
+  double cum_prod_ratio(const int *a, double a0, const int *b, const double *b0, const int *c, double c0,
+                        int size, double *cum); // cum[k] = sum_{j<=k} (a[j]+a0)*(b[j]+b0[j])/(c[j]+c0)
 
   // matrix
   template <typename T> void transpose(const std::vector<std::vector<T> > &mat, std::vector<std::vector<T> > &tmat);
   template <typename T> void save_matrix(const std::string &filename, const std::vector<std::vector<T> > &mat);
   template <typename T> void save_matrix_t(const std::string &filename, const std::vector<std::vector<T> > &mat); // with transpose
-  void load_matrix(const std::string &filename, std::vector<std::vector<double> > &mat);
+  void load_matrix(const std::string &filename, std::vector<std::vector<double> > &mat); // dense or sparse (index:value) rows
+
+  // sparse rows as "index:value" in descending values, keeping the top_k largest values
+  // (all if top_k <= 0) of those >= threshold, where index = ids[j] if ids are given
+  template <typename T> void write_sparse_row(std::ostream &out, const std::vector<T> &row, int top_k, double threshold,
+                                              const std::vector<int> &ids = std::vector<int>());
+  template <typename T> void save_sparse_matrix(const std::string &filename, const std::vector<std::vector<T> > &mat,
+                                                int top_k, double threshold, const std::vector<int> &ids = std::vector<int>());
 };
 
 #endif
@@ -28,20 +28,20 @@ class LinkCompiler(LinkParser):
             raise LinkParserException('Unknown link: {}'.format(link))
 
     def and_dnf(self, dnf1, dnf2):
-        dnf = dnf1 & dnf2
-        if self.online_shrink:
-            dnf.shrink()
-        return dnf
+        if self.online_shrink: # drop absorbed conjunctions while making products
+            return dnf1.and_shrink(dnf2)
+        return dnf1 & dnf2
 
     def or_dnf(self, dnf1, dnf2):
-        dnf = dnf1 | dnf2
         if self.online_shrink:
-            dnf.shrink()
-        return dnf
+            return dnf1.or_shrink(dnf2)
+        return dnf1 | dnf2
 
     def compile(self, text):
+        Conj.reset_words() # bits from 0 for the words of this text
         dnf = self.parser.parse(text)
-        dnf.shrink()
+        if not self.online_shrink: # otherwise already shrunk
+            dnf.shrink()
         if self.verbose:
             print('compiled DNF: {}'.format(dnf))
             for i, conj in enumerate(dnf):
@@ -7,18 +7,49 @@ class DNF:
         # reduce the number of conjunctions by the following rules:
         # Fact (1): X | (X & Y) = X
         # Proposition (a): Ep(A,B) | (Np(A) & Np(B)) = Ep(A,B)
-        for i in range(len(self.dnf)-1):
-            if not self.dnf[i]: # already removed
-                continue
-            for j in range(i+1, len(self.dnf)):
-                if not self.dnf[j]: # already removed
-                    continue
-                if self.dnf[j].is_subconj_ep(self.dnf[i]):
-                    self.dnf[i] = None
-                    break # move to dnf[i+1]
-                if self.dnf[i].is_subconj_ep(self.dnf[j]):
-                    self.dnf[j] = None
-        self.dnf = list(filter(None, self.dnf))
+        #
+        # X can absorb Y only if Np(X) <= Np(Y) and words(X) <= words(Y), so
+        # visiting conjunctions by increasing sizes of Np and words (and finer
+        # Eps first) lets only already kept ones absorb the current one.
+        # Kept ones are indexed by their rarest word, which must be in
+        # words(Y) to absorb Y.
+        freqs = self.freqs()
+        order = sorted(range(len(self.dnf)), key=lambda i: self.dnf[i].sort_key())
+        index = {} # rarest word bit -> kept conjunctions (0 for empty ones)
+        keep = [False] * len(self.dnf)
+        for i in order:
+            conj = self.dnf[i]
+            if any(c.is_subconj_ep(conj) for c in index.get(0, [])):
+                continue # empty conj absorbs everything
+            absorbed = False
+            for bit in Conj.iter_bits(conj.mask):
+                if any(c.mask & ~conj.mask == 0 and c.is_subconj_ep(conj) for c in index.get(bit, [])):
+                    absorbed = True
+                    break
+            if not absorbed:
+                key = min(Conj.iter_bits(conj.mask), key=freqs.get, default=0)
+                index.setdefault(key, []).append(conj)
+                keep[i] = True
+        self.dnf = [conj for i, conj in enumerate(self.dnf) if keep[i]]
+
+    def and_shrink(self, other):
+        # (X1 | X2 | ..) & (Y1 | Y2 | ..) without keeping absorbed products,
+        # so that the result never grows beyond the shrunk DNF
+        if not self.mask() & other.mask():
+            # on disjoint words, Xi & Yj absorbs Xk & Yl only if Xi absorbs Xk
+            # and Yj absorbs Yl, so products of shrunk DNFs are already shrunk
+            return self & other
+        conjs = ConjSet(self.freqs(len(other)), other.freqs(len(self)))
+        for c1 in self.dnf:
+            for c2 in other.dnf:
+                conjs.add(c1 & c2)
+        return DNF(conjs.conjs())
+
+    def or_shrink(self, other):
+        conjs = ConjSet(self.freqs(), other.freqs())
+        for conj in self.dnf + other.dnf:
+            conjs.add(conj.copy())
+        return DNF(conjs.conjs())
 
     def save(self, filename):
         with open(filename, 'w') as f:
@@ -48,6 +79,19 @@ class DNF:
                 exit('Unknown word id: {}'.format(wid))
         return words
 
+    def freqs(self, weight=1): # word bit -> number of conjs with the word
+        freqs = {}
+        for conj in self.dnf:
+            for bit in Conj.iter_bits(conj.mask):
+                freqs[bit] = freqs.get(bit, 0) + weight
+        return freqs
+
+    def mask(self):
+        mask = 0
+        for conj in self.dnf:
+            mask |= conj.mask
+        return mask
+
     def words(self):
         words = set()
         for conj in self.dnf:
@@ -93,10 +137,99 @@ class DNF:
         return len(self.dnf)
 
 
+class ConjSet:
+    # set of conjunctions where none absorbs another by Fact (1) or
+    # Proposition (a), updated by each insertion. freqs are expected
+    # frequencies of words to index each conj by its rarest word.
+    def __init__(self, *freqs):
+        self.freqs = {}
+        for f in freqs:
+            for bit, freq in f.items():
+                self.freqs[bit] = self.freqs.get(bit, 0) + freq
+        self.table = {} # id -> conj
+        self.words = {} # word bit -> ids of conjs with the word
+        self.keys = {} # rarest word bit (0 for empty conj) -> ids
+        self.next_id = 0
+
+    def key(self, conj):
+        return min(Conj.iter_bits(conj.mask), key=lambda bit: self.freqs.get(bit, 0), default=0)
+
+    def add(self, conj):
+        # X can absorb Y only if words(X) <= words(Y), so X has its key in words(Y)
+        for bit in [0] + list(Conj.iter_bits(conj.mask)):
+            for i in self.keys.get(bit, ()):
+                c = self.table[i]
+                if c.mask & ~conj.mask == 0 and c.is_subconj_ep(conj):
+                    return False
+
+        # remove ones absorbed by conj, which have all words of conj
+        if conj.mask:
+            bits = list(Conj.iter_bits(conj.mask))
+            cands = min((self.words.get(bit, set()) for bit in bits), key=len)
+        else:
+            cands = self.table.keys()
+        for i in [i for i in cands if conj.mask & ~self.table[i].mask == 0
+                  and conj.is_subconj_ep(self.table[i])]:
+            self.remove(i)
+
+        i = self.next_id
+        self.next_id += 1
+        self.table[i] = conj
+        for bit in Conj.iter_bits(conj.mask):
+            self.words.setdefault(bit, set()).add(i)
+        self.keys.setdefault(self.key(conj), set()).add(i)
+        return True
+
+    def remove(self, i):
+        conj = self.table.pop(i)
+        for bit in Conj.iter_bits(conj.mask):
+            self.words[bit].discard(i)
+        self.keys[self.key(conj)].discard(i)
+
+    def conjs(self):
+        return list(self.table.values())
+
+    def __len__(self):
+        return len(self.table)
+
+
+class WordBits:
+    # words interned into bit positions, shared by conjunctions built together
+    def __init__(self):
+        self.word2bit = {}
+        self.bit2word = []
+
+    def to_bit(self, word):
+        if word not in self.word2bit:
+            self.word2bit[word] = 1 << len(self.bit2word)
+            self.bit2word.append(word)
+        return self.word2bit[word]
+
+    def to_bits(self, words):
+        bits = 0
+        for word in words:
+            bits |= self.to_bit(word)
+        return bits
+
+    def to_words(self, bits):
+        return set(self.bit2word[bit.bit_length()-1] for bit in Conj.iter_bits(bits))
+
+
 class Conj:
+    # words are interned into bit positions of a WordBits table, so that each Ep and
+    # the Nps are kept as int bitsets; new conjunctions take the current table, which
+    # reset_words() replaces (e.g. for each compile) while earlier ones keep theirs
+    word_bits = WordBits()
+
+    @classmethod
+    def reset_words(cls):
+        cls.word_bits = WordBits()
+
     def __init__(self, eps=None, np=None):
-        self.eps = []
-        self.np = set()
+        self.word_bits = Conj.word_bits
+        self._eps = [] # list of bitsets
+        self._np = 0 # bitset
+        self.mask = 0 # bitset of all words
         if eps:
             for words in eps:
                 self.add_ep(words)
@@ -104,42 +237,76 @@ class Conj:
             for word in np:
                 self.add_np(word)
 
+    def to_bit(self, word):
+        return self.word_bits.to_bit(word)
+
+    def to_bits(self, words):
+        return self.word_bits.to_bits(words)
+
+    def to_words(self, bits):
+        return self.word_bits.to_words(bits)
+
+    @staticmethod
+    def iter_bits(bits):
+        while bits:
+            low = bits & -bits
+            yield low
+            bits ^= low
+
+    @property
+    def eps(self):
+        return [self.to_words(ep) for ep in self._eps]
+
+    @property
+    def np(self):
+        return self.to_words(self._np)
+
+    def sort_key(self):
+        return (bin(self._np).count('1'), bin(self.mask).count('1'), -len(self._eps))
+
     def add_ep(self, words):
         assert isinstance(words, (list, tuple, set)), 'Ep needs a list/tuple/set'
         assert len(words) >= 2, 'Ep needs at least two words'
-        new_ep = set(words)
-        for i, ep in enumerate(self.eps):
+        self.add_ep_bits(self.to_bits(words))
+
+    def add_ep_bits(self, new_ep):
+        self.mask |= new_ep
+        # Fact (0): Ep(A,B) & Ep(B,C) = Ep(A,B,C)
+        eps = []
+        for ep in self._eps:
             if new_ep & ep:
-                # Fact (0): Ep(A,B) & Ep(B,C) = Ep(A,B,C)
                 new_ep |= ep
-                self.eps[i] = None
-        self.eps = list(filter(None, self.eps))
+            else:
+                eps.append(ep)
 
-        if new_ep & self.np:
+        if new_ep & self._np:
             # Proposision (b): Ep(A,B) & Np(A) = Np(A) & Np(B)
-            self.np |= new_ep
+            self._np |= new_ep
         else:
-            self.eps.append(new_ep)
+            eps.append(new_ep)
+        self._eps = eps
 
     def add_np(self, word):
-        for i, ep in enumerate(self.eps):
-            if word in ep:
-                # Proposision (b): Ep(A,B) & Np(A) = Np(A) & Np(B)
-                self.np |= ep
-                self.eps.pop(i)
-                break
-        else:
-            self.np.add(word)
+        self.add_np_bits(self.to_bit(word))
+
+    def add_np_bits(self, bits):
+        self.mask |= bits
+        # Proposision (b): Ep(A,B) & Np(A) = Np(A) & Np(B)
+        eps = []
+        for ep in self._eps:
+            if bits & ep:
+                bits |= ep
+            else:
+                eps.append(ep)
+        self._eps = eps
+        self._np |= bits
 
     def is_subconj(self, other): # obsolete
         # Fact (1): (X & Y) | X = X
-        if not self.np <= other.np:
+        if self._np & ~other._np:
             return False
-        for ep in self.eps:
-            for ep2 in other.eps:
-                if ep <= ep2:
-                    break
-            else: # if not ep <= ep2
+        for ep in self._eps:
+            if not any(ep & ~ep2 == 0 for ep2 in other._eps):
                 return False
         return True
 
@@ -155,17 +322,15 @@ class Conj:
         # = P & ( Ep(A,B,..) | (Ep(A,B,..) & Q) )
         # = P & Ep(A,B,..)
 
-        if not self.np <= other.np: # if np is not in P
+        if self._np & ~other._np: # if np is not in P
             return False
 
-        np_dif = other.np - self.np # = Np(A) & Np(B) & .. & Q
-        for ep in self.eps:
-            for ep2 in other.eps:
-                if ep <= ep2: # if ep is in P
-                    break
-            else: # if ep is not in P
-                if not ep <= np_dif: # if ep is not Ep(A,B,..)
-                    return False
+        np_dif = other._np & ~self._np # = Np(A) & Np(B) & .. & Q
+        for ep in self._eps:
+            if ep & ~np_dif == 0: # if ep is Ep(A,B,..)
+                continue
+            if not any(ep & ~ep2 == 0 for ep2 in other._eps): # if ep is not in P
+                return False
         return True
 
     def get_save_str(self):
@@ -188,11 +353,7 @@ class Conj:
         return ids
 
     def words(self):
-        words = []
-        for ep in self.eps:
-            words += list(ep)
-        words += list(self.np)
-        return sorted(words)
+        return sorted(self.to_words(self.mask))
 
     def atf(self, words): # asymptotic topic family on words
         if self.eps == [] and self.np == []:
@@ -225,16 +386,17 @@ class Conj:
 
     def copy(self):
         new_conj = Conj()
-        new_conj.eps = [ep.copy() for ep in self.eps]
-        new_conj.np = self.np.copy()
+        new_conj.word_bits = self.word_bits
+        new_conj._eps = list(self._eps)
+        new_conj._np = self._np
+        new_conj.mask = self.mask
         return new_conj
 
     def __and__(self, other):
         new_conj = self.copy()
-        for ep in other.eps:
-            new_conj.add_ep(ep)
-        for word in other.np:
-            new_conj.add_np(word)
+        for ep in other._eps:
+            new_conj.add_ep_bits(ep)
+        new_conj.add_np_bits(other._np)
         return new_conj
 
     def __eq__(self, other):
@@ -0,0 +1,106 @@
+import random
+import sys
+
+from bisect import bisect
+from itertools import accumulate
+
+from compiler import LinkCompiler
+
+class MakeBench:
+    def __init__(self, out_base, num_docs=1000, num_words=10000, doc_len=100, zipf=1.0,
+                 num_mls=4, num_cls=4, top_words=100, seed=0):
+        self.out_base = out_base
+        self.dat_file = out_base + '.dat'
+        self.cst_file = out_base + '.cst'
+        self.dnf_file = out_base + '.dnf'
+        self.num_docs = num_docs
+        self.num_words = num_words
+        self.doc_len = doc_len
+        self.zipf = zipf
+        self.num_mls = num_mls
+        self.num_cls = num_cls
+        self.top_words = min(top_words, num_words)
+        self.random = random.Random(seed)
+
+    def run(self):
+        print('* Info:')
+        print('- dat_file: {}'.format(self.dat_file))
+        print('- cst_file: {}'.format(self.cst_file))
+        print('- dnf_file: {}'.format(self.dnf_file))
+        print('- num_docs: {}'.format(self.num_docs))
+        print('- num_words: {}'.format(self.num_words))
+        print('- doc_len: {}'.format(self.doc_len))
+        print('- zipf: {}'.format(self.zipf))
+        print('- num_mls: {}'.format(self.num_mls))
+        print('- num_cls: {}'.format(self.num_cls))
+        print('* Making dat file')
+        self.make_dat(self.dat_file)
+        print('* Making cst/dnf files')
+        self.make_cst(self.cst_file)
+        compiler = LinkCompiler(online_shrink=True)
+        compiler.compile_file(self.cst_file, self.dnf_file)
+        print('* Done')
+
+    def make_dat(self, dat_file):
+        # word-id w has the (w+1)-th largest frequency, i.e. p(w) ~ 1/(w+1)^zipf
+        cum_weights = list(accumulate(1.0 / (w + 1) ** self.zipf for w in range(self.num_words)))
+        total = cum_weights[-1]
+        with open(dat_file, 'w') as f:
+            for _ in range(self.num_docs):
+                freqs = {}
+                for _ in range(self.doc_len):
+                    w = bisect(cum_weights, self.random.random() * total)
+                    w = min(w, self.num_words - 1)
+                    freqs[w] = freqs.get(w, 0) + 1
+                f.write(' '.join('{}:{}'.format(w, freq) for w, freq in sorted(freqs.items())) + '\n')
+
+    def make_cst(self, cst_file):
+        # random MLs and CLs on frequent words, which are likely to appear in the same docs
+        links = []
+        for link, num in (('ML', self.num_mls), ('CL', self.num_cls)):
+            for _ in range(num):
+                w1, w2 = self.random.sample(range(self.top_words), 2)
+                links.append('{}({},{})'.format(link, w1, w2))
+        with open(cst_file, 'w') as f:
+            f.write('&'.join(links) + '\n')
+
+
+if __name__ == '__main__':
+    import argparse
+
+    desc = """
+Script to make a synthetic benchmark dataset (.dat/cst/dnf) with Zipfian word frequencies
+and random constraint links
+
+examples:
+python utils/%(prog)s -o out/bench/zipf
+python utils/%(prog)s -o out/bench/zipf -D 10000 -V 50000 -L 200 -M 8 -C 8"""
+    arg_parser = argparse.ArgumentParser(description=desc, formatter_class=argparse.RawDescriptionHelpFormatter)
+    arg_parser.add_argument('-o', '--out_base', metavar='PREF',
+                            help='output prefix of path to save .dat/cst/dnf files')
+    arg_parser.add_argument('-D', '--num_docs', metavar='N', type=int, default=1000,
+                            help='number of documents')
+    arg_parser.add_argument('-V', '--num_words', metavar='N', type=int, default=10000,
+                            help='size of vocabulary')
+    arg_parser.add_argument('-L', '--doc_len', metavar='N', type=int, default=100,
+                            help='number of terms in each document')
+    arg_parser.add_argument('-z', '--zipf', metavar='S', type=float, default=1.0,
+                            help='exponent of Zipf distribution on word frequencies')
+    arg_parser.add_argument('-M', '--num_mls', metavar='N', type=int, default=4,
+                            help='number of random ML links')
+    arg_parser.add_argument('-C', '--num_cls', metavar='N', type=int, default=4,
+                            help='number of random CL links')
+    arg_parser.add_argument('-t', '--top_words', metavar='N', type=int, default=100,
+                            help='number of most frequent words used in links')
+    arg_parser.add_argument('-s', '--seed', metavar='N', type=int, default=0,
+                            help='seed of random function')
+
+    args = arg_parser.parse_args()
+    if not args.out_base:
+        arg_parser.print_help()
+        exit()
+
+    mb = MakeBench(out_base=args.out_base, num_docs=args.num_docs, num_words=args.num_words,
+                   doc_len=args.doc_len, zipf=args.zipf, num_mls=args.num_mls, num_cls=args.num_cls,
+                   top_words=args.top_words, seed=args.seed)
+    mb.run()
@@ -70,6 +70,24 @@ class TestLinkCompiler(unittest.TestCase):
             words = dnf.words()
             self.assertEqual(ref.atf(words), dnf.atf(words))
 
+    def test_online_links(self):
+        online = LinkCompiler(debug=False, online_shrink=True)
+        for link in self.rand_links(10, 8, 100, 0):
+            dnf = online.compile(link)
+            ref = self.parser.parse(link)
+            ref.shrink()
+            words = ref.words()
+            self.assertEqual(len(ref), len(dnf))
+            self.assertEqual(ref.atf(words), dnf.atf(words))
+
+    def test_compile_words(self):
+        # words of each compile get bits from the lowest, and earlier DNFs keep theirs
+        dnf1 = self.dnf.compile('ML(a,b)&CL(b,c)')
+        dnf2 = self.dnf.compile('ML(x,y)')
+        self.assertEqual(0b11, dnf2.mask())
+        self.assertEqual('Ep(x,y)', str(dnf2))
+        self.assertEqual(['a','b','c'], dnf1.words())
+
     def all_links(self, n_words, n_links):
         assert n_words < 50 and n_links < 20, 'too big number!'
         from itertools import combinations
@@ -4,7 +4,7 @@ import sys
 from os.path import dirname, abspath
 sys.path.insert(0, dirname(abspath(__file__)) + '/../')
 
-from dnf import DNF, Conj
+from dnf import DNF, Conj, ConjSet
 
 class TestConj(unittest.TestCase):
     def test_add_ep(self):
@@ -124,6 +124,13 @@ class TestConj(unittest.TestCase):
         c2 = Conj([], [1,2])
         self.assertEqual(c1.atf([1,2]), c1.atf([1,2]) | c2.atf([1,2]))
 
+    def test_bits(self):
+        c = Conj([['x','y']], ['z'])
+        self.assertEqual(c.to_bits(['x','y','z']), c.mask)
+        self.assertEqual({'x','y','z'}, c.to_words(c.mask))
+        self.assertEqual([{'x','y'}], c.eps)
+        self.assertEqual({'z'}, c.np)
+
     def test_get_save_str(self):
         c = Conj([[1,2],[3,4]], [5,6])
         ref = '1,2:3,4;5,6'
@@ -191,6 +198,41 @@ class TestDNF(unittest.TestCase):
         dnf.shrink()
         self.assertEqual(ref, dnf)
 
+    def test_shrink_order(self):
+        # absorbing conj comes later or has finer Eps
+        dnf = DNF([Conj([[1,2,3,4]], []), Conj([], [5,6]), Conj([[1,2],[3,4]], []), Conj([], [5])])
+        ref = DNF([Conj([[1,2],[3,4]], []), Conj([], [5])])
+        dnf.shrink()
+        self.assertEqual(ref, dnf)
+        dnf = DNF([Conj([], ['a','b']), Conj([], []), Conj([['a','b']], [])])
+        ref = DNF([Conj([], [])])
+        dnf.shrink()
+        self.assertEqual(ref, dnf)
+
+    def test_and_shrink(self):
+        dnf1 = DNF([Conj([[1,2]],[]), Conj([],[3])])
+        dnf2 = DNF([Conj([],[1]), Conj([],[3,4])])
+        ref = dnf1 & dnf2
+        ref.shrink()
+        self.assertEqual(ref, dnf1.and_shrink(dnf2))
+        dnf2 = DNF([Conj([[5,6]],[]), Conj([],[7])]) # disjoint words
+        self.assertEqual(dnf1 & dnf2, dnf1.and_shrink(dnf2))
+
+    def test_or_shrink(self):
+        dnf1 = DNF([Conj([],[1,2]), Conj([],[3])])
+        dnf2 = DNF([Conj([[1,2]],[]), Conj([],[3,4])])
+        ref = DNF([Conj([[1,2]],[]), Conj([],[3])])
+        self.assertEqual(ref, dnf1.or_shrink(dnf2))
+
+    def test_conj_set(self):
+        conjs = ConjSet()
+        self.assertEqual(True, conjs.add(Conj([],[1,2])))
+        self.assertEqual(False, conjs.add(Conj([],[1,2,3])))
+        self.assertEqual(True, conjs.add(Conj([[1,2]],[])))
+        self.assertEqual(1, len(conjs))
+        self.assertEqual(True, conjs.add(Conj([],[])))
+        self.assertEqual([''], list(map(str, conjs.conjs())))
+
     def test_shrink_atf(self):
         dnf = DNF([Conj([[1,2],[3,4]], [5]), Conj([[3,4,5]], [1,2,5,6])])
         ref = DNF([Conj([[1,2],[3,4]], [5])])
@@ -0,0 +1,78 @@
+import unittest
+
+import sys
+from os.path import dirname, abspath
+sys.path.insert(0, dirname(abspath(__file__)) + '/../../')
+
+try:
+    import numpy as np
+    import pyldadf
+except ImportError:
+    pyldadf = None
+
+@unittest.skipUnless(pyldadf, 'pyldadf is not built (run make pyldadf in src)')
+class TestPyLDADF(unittest.TestCase):
+    def setUp(self):
+        # 4 docs of 3 words: 0:2 1:2 / 0:2 2:2 / 0:2 1:2 / 0:2 2:2
+        self.indptr = np.array([0,2,4,6,8], dtype=np.int32)
+        self.indices = np.array([0,1,0,2,0,1,0,2], dtype=np.int32)
+        self.freqs = np.full(8, 2, dtype=np.int32)
+
+    def test_lda(self):
+        lda = pyldadf.LDA(self.indptr, self.indices, self.freqs, num_topics=2, max_steps=10, seed=1)
+        lda.run()
+        self.assertEqual((2,3), lda.phi().shape)
+        self.assertEqual((4,2), lda.theta().shape)
+        self.assertTrue(np.allclose(lda.phi().sum(axis=1), 1.0))
+        self.assertTrue(np.allclose(lda.theta().sum(axis=1), 1.0))
+        self.assertEqual(16, lda.cwz().sum())
+        self.assertEqual([4]*4, list(lda.cdz().sum(axis=1)))
+        self.assertGreater(lda.perplexity(), 0.0)
+
+    def test_ldadf(self):
+        lda = pyldadf.LDADF(self.indptr, self.indices, self.freqs, num_topics=2, max_steps=10, seed=1,
+                            dnf=[';0,1', '0,1;2'], eta=10)
+        lda.run()
+        self.assertEqual((2,3), lda.phi().shape)
+        self.assertTrue(np.allclose(lda.phi().sum(axis=1), 1.0))
+        self.assertEqual(16, lda.cwz().sum())
+        self.assertEqual(2, len(lda.dz()))
+        self.assertTrue(all(t in (0,1) for t in lda.dz()))
+
+    def test_errors(self):
+        lda = pyldadf.LDA(self.indptr, self.indices, self.freqs)
+        self.assertRaises(RuntimeError, lda.phi)
+        indices = np.array([0,1,0,-2,0,1,0,2], dtype=np.int32)
+        self.assertRaises(ValueError, pyldadf.LDA, self.indptr, indices, self.freqs)
+        self.assertRaises(ValueError, pyldadf.LDA, self.indptr, self.indices, self.freqs[:4])
+        self.assertRaises(ValueError, pyldadf.LDADF, self.indptr, self.indices, self.freqs, dnf=['a;b'])
+        self.assertRaises(ValueError, pyldadf.LDADF, self.indptr, self.indices, self.freqs, dnf=['0,1'])
+
+    def test_int64(self):
+        lda = pyldadf.LDA(self.indptr.astype(np.int64), self.indices.astype(np.int64), self.freqs.astype(np.int64),
+                          num_topics=2, max_steps=2)
+        lda.run()
+        self.assertEqual(16, lda.cwz().sum())
+
+    def test_seed(self):
+        rng = np.random.RandomState(0)
+        indptr = np.arange(0, 201, 10, dtype=np.int32)
+        indices = rng.randint(0, 20, 200).astype(np.int32)
+        freqs = np.ones(200, dtype=np.int32)
+        def sample(seed):
+            lda = pyldadf.LDA(indptr, indices, freqs, num_topics=5, max_steps=1, seed=seed)
+            lda.run()
+            return lda.cdz()
+        self.assertTrue((sample(1) == sample(1)).all())
+        self.assertFalse((sample(1) == sample(2)).all())
+
+    def test_subclass(self):
+        class Uninitialized(pyldadf.LDA):
+            def __init__(self):
+                pass
+        lda = Uninitialized()
+        self.assertRaises(RuntimeError, lda.run)
+        self.assertRaises(RuntimeError, lda.phi)
+
+if __name__ == '__main__':
+    unittest.main()
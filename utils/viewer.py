@@ -45,13 +45,14 @@ class ParamViewer:
 
         self.print_text('- Word probabilities in each topic')
         prob_mat = self.load_mat(phi_file)
-        prob_mat = self.transpose(prob_mat)
+        if not self.is_sparse(phi_file):
+            prob_mat = [list(enumerate(probs)) for probs in self.transpose(prob_mat)]
         for tid, probs in enumerate(prob_mat):
             if tid >= self.num_topics:
                 self.print_text('...')
                 break
             self.print_text('<topic-{}>'.format(tid))
-            for word, prob in sorted(enumerate(probs), key=lambda x: -x[1])[:self.num_words]:
+            for word, prob in sorted(probs, key=lambda x: -x[1])[:self.num_words]:
                 if self.id2word:
                     if word in self.id2word:
                         word = self.id2word[word]
@@ -112,12 +113,14 @@ class ParamViewer:
 
         self.print_text('- Topic probabilities in each document')
         prob_mat = self.load_mat(theta_file)
+        if not self.is_sparse(theta_file):
+            prob_mat = [list(enumerate(probs)) for probs in prob_mat]
         for did, probs in enumerate(prob_mat):
             if did >= self.num_docs:
                 self.print_text('...')
                 break
             self.print_text('<doc-{}>'.format(did))
-            for tid, prob in sorted(enumerate(probs), key=lambda x: -x[1])[:self.num_topics]:
+            for tid, prob in sorted(probs, key=lambda x: -x[1])[:self.num_topics]:
                 self.print_text('topic-{}\t{:0.6f}'.format(tid, prob))
             if len(probs) > self.num_topics: self.print_text('...')
         self.print_text()
@@ -131,13 +134,24 @@ class ParamViewer:
         return id2word
 
     def load_mat(self, mat_file):
+        # rows of values, or rows of (index, value) if sparse (index:value)
         prob_mat = []
         with open(mat_file) as f:
             for line in f:
-                probs = map(float, line.strip().split())
+                if ':' in line:
+                    probs = [(int(i), float(v)) for i, v in (e.split(':') for e in line.strip().split())]
+                else:
+                    probs = map(float, line.strip().split())
                 prob_mat.append(list(probs))
         return prob_mat
 
+    def is_sparse(self, mat_file):
+        with open(mat_file) as f:
+            for line in f:
+                if line.strip():
+                    return ':' in line
+        return False
+
     def transpose(self, mat):
         return [[row[i] for row in mat] for i in range(len(mat[0]))]
 